@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+constexpr int BENCH_DEPTH = 4;
+
+// Search a fixed set of positions to a fixed depth and print the total node
+// count and speed. The node count doubles as a signature of the search: it
+// only changes when the search itself behaves differently.
+void bench(int depth = BENCH_DEPTH);
+
+#endif
@@ -31,6 +31,13 @@ VERSION: 0.5.11
 #ifndef CHESS_HPP
 #define CHESS_HPP
 
+// Slider attacks are looked up with PEXT when the target has BMI2. Define CHESS_NO_PEXT to
+// keep the magic multiplication on CPUs that implement PEXT in microcode, like AMD before
+// Zen 3.
+#if defined(__BMI2__) && !defined(CHESS_NO_PEXT)
+#define CHESS_USE_PEXT
+#endif
+
 #include <algorithm>
 #include <array>
 #include <bitset>
@@ -44,10 +51,15 @@ VERSION: 0.5.11
 #include <optional>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#ifdef CHESS_USE_PEXT
+#include <immintrin.h>
+#endif
+
 namespace chess {
 
 /****************************************************************************\
@@ -75,7 +87,12 @@ enum Square : uint8_t {
 };
 // clang-format on
 
-enum class MoveGenType : uint8_t { ALL, CAPTURE, QUIET };
+/// ALL, CAPTURE and QUIET split the legal moves into captures (including en passant and
+/// capturing promotions) and the rest. The other modes serve staged move picking:
+/// NOISY generates captures and queen promotions but no other promotions, QUIET_CHECK the
+/// non capturing moves that give check, without promotions and castling, and EVASION all
+/// legal moves when in check and none otherwise.
+enum class MoveGenType : uint8_t { ALL, CAPTURE, QUIET, NOISY, QUIET_CHECK, EVASION };
 
 enum class Direction : int8_t {
     NORTH      = 8,
@@ -179,6 +196,7 @@ namespace constants {
 constexpr int MAX_SQ                 = 64;
 constexpr int MAX_PIECE              = 12;
 constexpr int MAX_MOVES              = 256;
+constexpr int MAX_HISTORY            = 512;  // Undo states kept inline in a Board
 constexpr Bitboard DEFAULT_CHECKMASK = 0xFFFFFFFFFFFFFFFF;  // 18446744073709551615ULL
 
 static const std::string STARTPOS = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -416,7 +434,7 @@ struct Movelist {
     /// otherwise -1.
     /// @param move
     /// @return
-    constexpr int find(Move move) {
+    [[nodiscard]] constexpr int find(Move move) const {
         for (int i = 0; i < size_; ++i) {
             if (moves_[i] == move) {
                 return i;
@@ -659,6 +677,17 @@ inline int popcount(U64 mask) {
 #endif
 }
 
+/// @brief Mirror a bitboard vertically, rank 1 becomes rank 8 and the other way around.
+/// @param b
+/// @return
+inline Bitboard flipVertical(Bitboard b) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(b);
+#else
+    return __builtin_bswap64(b);
+#endif
+}
+
 /// @brief Get the least significant bit of a U64 and pop it.
 /// @param mask
 /// @return
@@ -919,6 +948,7 @@ class Zobrist {
 
    public:
     friend class Board;
+    friend struct Position;
 };
 
 /****************************************************************************\
@@ -935,6 +965,8 @@ enum PieceGenType {
 };
 
 class Board;
+struct Position;
+struct AttackInfo;
 
 namespace movegen {
 
@@ -948,6 +980,54 @@ void legalmoves(Movelist &movelist, const Board &board,
                 int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
                              PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
 
+/// @brief Generates all legal moves for a position, reusing the checkers and pins of an
+/// AttackInfo. The movelist will be emptied before adding the moves.
+/// @tparam mt
+/// @param movelist
+/// @param board
+/// @param info board.attackInfo()
+template <MoveGenType mt = MoveGenType::ALL>
+void legalmoves(Movelist &movelist, const Board &board, const AttackInfo &info,
+                int pieces = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
+                             PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING);
+
+/// @brief Counts the legal moves of a position without creating them, several times
+/// faster than the size of the list legalmoves would produce.
+/// @tparam mt
+/// @param board
+/// @return
+template <MoveGenType mt = MoveGenType::ALL>
+[[nodiscard]] int countLegal(const Board &board);
+
+/// @brief Checks if the side to move has a legal move, stopping at the first piece that
+/// has one.
+/// @param board
+/// @return
+[[nodiscard]] bool hasAnyLegalMove(const Board &board);
+
+/// @brief Legal moves of one position as computed by legalTargets. The bitboards are the
+/// union of the destination squares per kind of moving piece, castling appears as the
+/// square of the rook like in the Move encoding.
+struct LegalTargets {
+    Bitboard pawns;
+    Bitboard knights;
+    Bitboard diagonal;    // Bishops and queens moving diagonally
+    Bitboard orthogonal;  // Rooks and queens moving straight
+    Bitboard king;
+    int count;  // Number of legal moves, a promotion counts as four
+};
+
+/// @brief Computes the legal move targets of many positions. Positions are processed in
+/// groups of BATCH_LANES, one per vector lane.
+/// @param positions
+/// @param targets receives one entry per position
+/// @param count
+void legalTargets(const Position *positions, LegalTargets *targets, size_t count);
+
+/// @brief [Internal Usage] legalTargets for as many positions as B has lanes.
+template <typename B>
+void legalTargetLanes(const Position *positions, LegalTargets *targets);
+
 }  // namespace movegen
 
 /****************************************************************************\
@@ -961,7 +1041,15 @@ class attacks {
         U64 *attacks;
         U64 shift;
 
-        U64 operator()(U64 b) const { return ((b & mask) * magic) >> shift; }
+        // Both indexings fill the 2^popcount(mask) entries of the square, so the tables
+        // have the same layout
+        U64 operator()(U64 b) const {
+#ifdef CHESS_USE_PEXT
+            return _pext_u64(b, mask);
+#else
+            return ((b & mask) * magic) >> shift;
+#endif
+        }
     };
 
     /// @brief [Internal Usage] Slow function to calculate bishop attacks
@@ -982,7 +1070,7 @@ class attacks {
     /// @param magic
     /// @param attacks
     static void initSliders(Square sq, Magic table[], U64 magic,
-                            const std::function<Bitboard(Square, Bitboard)> &attacks);
+                            Bitboard (*attacks)(Square, Bitboard));
 
     // clang-format off
     // pre-calculated lookup table for pawn attacks
@@ -1108,6 +1196,13 @@ class attacks {
     static inline Magic BishopTable[constants::MAX_SQ] = {};
 
    public:
+    /// @brief Name of the slider attack indexing chosen at compile time.
+#ifdef CHESS_USE_PEXT
+    static constexpr const char *SLIDER_BACKEND = "pext";
+#else
+    static constexpr const char *SLIDER_BACKEND = "magic";
+#endif
+
     static constexpr Bitboard MASK_RANK[8] = {
         0xff,         0xff00,         0xff0000,         0xff000000,
         0xff00000000, 0xff0000000000, 0xff000000000000, 0xff00000000000000};
@@ -1121,8 +1216,8 @@ class attacks {
     /// @tparam direction
     /// @param b
     /// @return
-    template <Direction direction>
-    [[nodiscard]] static constexpr Bitboard shift(const Bitboard b);
+    template <Direction direction, typename B = Bitboard>
+    [[nodiscard]] static constexpr B shift(const B b);
 
     /// @brief Generate the left side pawn attacks.
     /// @tparam c
@@ -1172,6 +1267,49 @@ class attacks {
     /// @return
     [[nodiscard]] static Bitboard king(Square sq);
 
+    /// @brief Setwise attacks of all sliders in one direction, found with a Kogge-Stone
+    /// occluded fill instead of table lookups. Every ray includes its first blocker.
+    /// @tparam direction
+    /// @tparam B Bitboard or a vector of bitboards, see movegen::BatchLanes
+    /// @param sliders
+    /// @param occupied
+    /// @return
+    template <Direction direction, typename B = Bitboard>
+    [[nodiscard]] static constexpr B slide(B sliders, B occupied);
+
+    /// @brief Returns the union of the attacks of all given knights
+    /// @param knights
+    /// @return
+    template <typename B = Bitboard>
+    [[nodiscard]] static constexpr B knightSet(B knights);
+
+    /// @brief Returns the union of the attacks of all given bishops, setwise
+    /// @param bishops
+    /// @param occupied
+    /// @return
+    template <typename B = Bitboard>
+    [[nodiscard]] static constexpr B bishopSet(B bishops, B occupied);
+
+    /// @brief Returns the union of the attacks of all given rooks, setwise
+    /// @param rooks
+    /// @param occupied
+    /// @return
+    template <typename B = Bitboard>
+    [[nodiscard]] static constexpr B rookSet(B rooks, B occupied);
+
+    /// @brief Returns the union of the attacks of all given queens, setwise
+    /// @param queens
+    /// @param occupied
+    /// @return
+    template <typename B = Bitboard>
+    [[nodiscard]] static constexpr B queenSet(B queens, B occupied);
+
+    /// @brief Returns the union of the attacks of all given kings
+    /// @param kings
+    /// @return
+    template <typename B = Bitboard>
+    [[nodiscard]] static constexpr B kingSet(B kings);
+
     /// @brief Returns a bitboard with the origin squares of the attacking pieces set
     /// @param board
     /// @param color Attacker Color
@@ -1189,6 +1327,52 @@ class attacks {
 /****************************************************************************\
  * Board                                                                     *
 \****************************************************************************/
+
+/// @brief Default hooks of Board::makeMove and Board::unmakeMove, which do nothing.
+/// Extensions such as an incremental evaluation pass their own type with the same two
+/// members to follow every piece placed or removed. The calls are resolved at compile
+/// time, so the default Board needs no vtable and makeMove inlines into straight-line code.
+/// After setFen, an extension has to rebuild its state from the board.
+struct NoHooks {
+    constexpr void placePiece(Piece, Square) const {}
+    constexpr void removePiece(Piece, Square) const {}
+};
+
+/// @brief Per-position data for Board::givesCheck, computed once with Board::checkInfo()
+/// and then shared by all moves of the position.
+struct CheckInfo {
+    /// @brief Squares from which a piece of each PieceType attacks the enemy king
+    Bitboard check_squares[6];
+    /// @brief Pieces of the side to move whose departure uncovers a slider on the enemy king
+    Bitboard discoverers;
+    Square king_sq;
+};
+
+/// @brief Attack data of one position, computed once with Board::attackInfo() and then shared
+/// by move generation, givesCheck, the static exchange evaluation and evaluation terms.
+/// Members without a color refer to the side to move.
+struct AttackInfo {
+    /// @brief Enemy pieces giving check
+    Bitboard checkers;
+    /// @brief Squares a move other than a king move has to end on, all squares if not in check
+    Bitboard check_mask;
+    /// @brief Rays from the king to the enemy rook or queen pinning a piece, pinner included
+    Bitboard pin_hv;
+    /// @brief Rays from the king to the enemy bishop or queen pinning a piece, pinner included
+    Bitboard pin_d;
+    /// @brief Own pieces pinned to the king
+    Bitboard pinned;
+    /// @brief Squares attacked by the pieces of each Color and PieceType
+    Bitboard attacked_by[2][6];
+    /// @brief Squares attacked by any piece of each Color
+    Bitboard attacked[2];
+    /// @brief Squares attacked by the enemy once the king stepped off its square, the king
+    /// cannot move there
+    Bitboard king_danger;
+    /// @brief Data for givesCheck
+    CheckInfo check_info;
+};
+
 class Board {
    private:
     class CastlingRights {
@@ -1307,6 +1491,7 @@ class Board {
         uint8_t half_moves;
         Piece captured_piece;
 
+        State() = default;
         State(const U64 &hash, const CastlingRights &castling, const Square &enpassant,
               const uint8_t &half_moves, const Piece &captured_piece)
             : hash(hash),
@@ -1316,17 +1501,91 @@ class Board {
               captured_piece(captured_piece) {}
     };
 
+    /// @brief Fixed capacity stack of the states needed to unmake moves. It lives inside the
+    /// board, so neither copying a board nor making and unmaking moves allocates, and copies
+    /// only copy the used part. When it is full the oldest states are dropped; those moves can
+    /// no longer be unmade, but they are too old to be part of a repetition.
+    class StateStack {
+       public:
+        StateStack() = default;
+        StateStack(const StateStack &other) : size_(other.size_) {
+            std::copy(other.states_, other.states_ + size_, states_);
+        }
+        StateStack &operator=(const StateStack &other) {
+            size_ = other.size_;
+            std::copy(other.states_, other.states_ + size_, states_);
+            return *this;
+        }
+
+        template <typename... Args>
+        void emplace_back(Args &&...args) {
+            if (size_ == constants::MAX_HISTORY) compact();
+            states_[size_++] = State(std::forward<Args>(args)...);
+        }
+
+        void pop_back() {
+            assert(size_ > 0);
+            size_--;
+        }
+
+        [[nodiscard]] const State &back() const { return states_[size_ - 1]; }
+        [[nodiscard]] const State &operator[](int index) const { return states_[index]; }
+        [[nodiscard]] int size() const { return size_; }
+        void clear() { size_ = 0; }
+
+       private:
+        /// @brief The half move clock is 8 bits wide, so a repetition never reaches back more
+        /// than KEEP states.
+        static constexpr int KEEP = 256;
+        static_assert(constants::MAX_HISTORY > KEEP);
+
+        void compact() {
+            std::copy(states_ + size_ - KEEP, states_ + size_, states_);
+            size_ = KEEP;
+        }
+
+        State states_[constants::MAX_HISTORY];
+        int size_ = 0;
+    };
+
    public:
     explicit Board(std::string_view fen = constants::STARTPOS);
 
-    virtual void setFen(std::string_view fen);
+    void setFen(std::string_view fen);
 
     /// @brief Get the current FEN string.
     /// @return
     [[nodiscard]] std::string getFen(bool move_counters = true) const;
 
-    void makeMove(const Move &move);
-    void unmakeMove(const Move &move);
+    void makeMove(const Move &move) {
+        NoHooks hooks;
+        makeMove(move, hooks);
+    }
+
+    void unmakeMove(const Move &move) {
+        NoHooks hooks;
+        unmakeMove(move, hooks);
+    }
+
+    /// @brief Makes a move and reports every piece it places or removes to hooks, see NoHooks.
+    /// @tparam Hooks
+    /// @param move
+    /// @param hooks
+    template <typename Hooks>
+    void makeMove(const Move &move, Hooks &hooks);
+
+    /// @brief Unmakes a move and reports every piece it places or removes to hooks.
+    /// @tparam Hooks
+    /// @param move
+    /// @param hooks
+    template <typename Hooks>
+    void unmakeMove(const Move &move, Hooks &hooks);
+
+    /// @brief Computes the hash key of the position after the move, without making it.
+    /// Cheaper than makeMove() and meant for prefetching hash table entries.
+    /// @param move
+    /// @return
+    [[nodiscard]] U64 hashAfter(const Move &move) const;
 
     /// @brief Make a null move. (Switches the side to move)
     void makeNullMove();
@@ -1446,12 +1705,7 @@ class Board {
     /// @brief Only call this function if isHalfMoveDraw() returns true.
     /// @return
     [[nodiscard]] std::pair<GameResultReason, GameResult> getHalfMoveDrawType() const {
-        const Board &board = *this;
-
-        Movelist movelist;
-        movegen::legalmoves<MoveGenType::ALL>(movelist, board);
-
-        if (movelist.empty() && inCheck()) {
+        if (!movegen::hasAnyLegalMove(*this) && inCheck()) {
             return {GameResultReason::CHECKMATE, GameResult::LOSE};
         }
 
@@ -1478,6 +1732,79 @@ class Board {
     /// @return
     [[nodiscard]] bool inCheck() const;
 
+    /// @brief Checks if a move, e.g. from a hash table, a killer slot or a book, is one that
+    /// move generation could produce here when ignoring whether it leaves the own king in
+    /// check. Castling moves are validated completely. Much cheaper than generating all moves.
+    /// @param move
+    /// @return
+    [[nodiscard]] bool isPseudoLegal(const Move &move) const;
+
+    /// @brief Checks if a pseudo legal move does not leave the own king in check.
+    /// @param move
+    /// @return
+    [[nodiscard]] bool isLegal(const Move &move) const;
+
+    /// @brief Computes the check squares and discovered check candidates of the position.
+    /// @return
+    [[nodiscard]] CheckInfo checkInfo() const;
+
+    /// @brief Checks if a pseudo legal move gives check, without making it.
+    /// @param move
+    /// @param info checkInfo() of this position
+    /// @return
+    [[nodiscard]] bool givesCheck(const Move &move, const CheckInfo &info) const;
+
+    /// @brief Checks if a pseudo legal move gives check. Prefer the overload taking a
+    /// CheckInfo when testing several moves of the same position.
+    /// @param move
+    /// @return
+    [[nodiscard]] bool givesCheck(const Move &move) const { return givesCheck(move, checkInfo()); }
+
+    /// @brief Checks if a pseudo legal move gives check.
+    /// @param move
+    /// @param info attackInfo() of this position
+    /// @return
+    [[nodiscard]] bool givesCheck(const Move &move, const AttackInfo &info) const {
+        return givesCheck(move, info.check_info);
+    }
+
+    /// @brief Computes the checkers, pins and attacked squares of both sides. Pass the result
+    /// to legalmoves, givesCheck and the static exchange evaluation instead of letting each
+    /// of them compute its share again.
+    /// @return
+    [[nodiscard]] AttackInfo attackInfo() const;
+
+    /// @brief Piece values used by the static exchange evaluation, indexed by PieceType.
+    static constexpr int SEE_VALUES[7] = {100, 300, 300, 500, 900, 20000, 0};
+
+    /// @brief Static exchange evaluation: the material balance of the exchange sequence on
+    /// the target square of the move, where both sides always recapture with their least
+    /// valuable attacker and may stop at any time. Pins are ignored.
+    /// @param move
+    /// @return
+    [[nodiscard]] int see(const Move &move) const;
+
+    /// @brief Static exchange evaluation, returns right away for moves to squares the enemy
+    /// cannot recapture on.
+    /// @param move
+    /// @param info attackInfo() of this position
+    /// @return
+    [[nodiscard]] int see(const Move &move, const AttackInfo &info) const;
+
+    /// @brief Checks if see(move) >= threshold, usually faster than computing the value.
+    /// @param move
+    /// @param threshold
+    /// @return
+    [[nodiscard]] bool seeGe(const Move &move, int threshold) const;
+
+    /// @brief Checks if see(move) >= threshold, returns right away for moves to squares the
+    /// enemy cannot recapture on.
+    /// @param move
+    /// @param threshold
+    /// @param info attackInfo() of this position
+    /// @return
+    [[nodiscard]] bool seeGe(const Move &move, int threshold, const AttackInfo &info) const;
+
     /// @brief Checks if the given color has at least 1 piece thats not pawn and not king
     /// @return
     [[nodiscard]] bool hasNonPawnMaterial(Color color) const;
@@ -1489,10 +1816,22 @@ class Board {
     friend std::ostream &operator<<(std::ostream &os, const Board &board);
 
    protected:
-    virtual void placePiece(Piece piece, Square sq);
-    virtual void removePiece(Piece piece, Square sq);
+    void placePiece(Piece piece, Square sq);
+    void removePiece(Piece piece, Square sq);
+
+    template <typename Hooks>
+    void placePiece(Piece piece, Square sq, Hooks &hooks) {
+        placePiece(piece, sq);
+        hooks.placePiece(piece, sq);
+    }
+
+    template <typename Hooks>
+    void removePiece(Piece piece, Square sq, Hooks &hooks) {
+        removePiece(piece, sq);
+        hooks.removePiece(piece, sq);
+    }
 
-    std::vector<State> prev_states_;
+    StateStack prev_states_;
 
     U64 pieces_bb_[2][6]         = {};
     std::array<Piece, 64> board_ = {};
@@ -1655,7 +1994,6 @@ inline void Board::setFenInternal(std::string_view fen) {
     occ_all_  = all();
 
     prev_states_.clear();
-    prev_states_.reserve(150);
 }
 
 inline void Board::setFen(std::string_view fen) { setFenInternal(fen); }
@@ -1801,8 +2139,8 @@ inline std::string Board::getCastleString() const {
 inline bool Board::isRepetition(int count) const {
     uint8_t c = 0;
 
-    for (int i = static_cast<int>(prev_states_.size()) - 2;
-         i >= 0 && i >= static_cast<int>(prev_states_.size()) - half_moves_ - 1; i -= 2) {
+    for (int i = prev_states_.size() - 2; i >= 0 && i >= prev_states_.size() - half_moves_ - 1;
+         i -= 2) {
         if (prev_states_[i].hash == hash_key_) c++;
 
         if (c == count) return true;
@@ -1843,12 +2181,7 @@ inline std::pair<GameResultReason, GameResult> Board::isGameOver() const {
 
     if (isRepetition()) return {GameResultReason::THREEFOLD_REPETITION, GameResult::DRAW};
 
-    const Board &board = *this;
-
-    Movelist movelist;
-    movegen::legalmoves<MoveGenType::ALL>(movelist, board);
-
-    if (movelist.empty()) {
+    if (!movegen::hasAnyLegalMove(*this)) {
         if (inCheck()) return {GameResultReason::CHECKMATE, GameResult::LOSE};
         return {GameResultReason::STALEMATE, GameResult::DRAW};
     }
@@ -1897,7 +2230,8 @@ inline void Board::removePiece(Piece piece, Square sq) {
     occ_all_ &= ~(1ULL << sq);
 }
 
-inline void Board::makeMove(const Move &move) {
+template <typename Hooks>
+inline void Board::makeMove(const Move &move, Hooks &hooks) {
     const auto capture  = at(move.to()) != Piece::NONE && move.typeOf() != Move::CASTLING;
     const auto captured = at(move.to());
     const auto pt       = at<PieceType>(move.from());
@@ -1914,7 +2248,7 @@ inline void Board::makeMove(const Move &move) {
         half_moves_ = 0;
 
         hash_key_ ^= Zobrist::piece(captured, move.to());
-        removePiece(captured, move.to());
+        removePiece(captured, move.to(), hooks);
 
         const auto rank = utils::squareRank(move.to());
 
@@ -1976,14 +2310,14 @@ inline void Board::makeMove(const Move &move) {
         const auto king = at(move.from());
         const auto rook = at(move.to());
 
-        removePiece(king, move.from());
-        removePiece(rook, move.to());
+        removePiece(king, move.from(), hooks);
+        removePiece(rook, move.to(), hooks);
 
         assert(king == utils::makePiece(side_to_move_, PieceType::KING));
         assert(rook == utils::makePiece(side_to_move_, PieceType::ROOK));
 
-        placePiece(king, kingTo);
-        placePiece(rook, rookTo);
+        placePiece(king, kingTo, hooks);
+        placePiece(rook, rookTo, hooks);
 
         hash_key_ ^= Zobrist::piece(king, move.from()) ^ Zobrist::piece(king, kingTo);
         hash_key_ ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, rookTo);
@@ -1991,8 +2325,8 @@ inline void Board::makeMove(const Move &move) {
         const auto piece_pawn = utils::makePiece(side_to_move_, PieceType::PAWN);
         const auto piece_prom = utils::makePiece(side_to_move_, move.promotionType());
 
-        removePiece(piece_pawn, move.from());
-        placePiece(piece_prom, move.to());
+        removePiece(piece_pawn, move.from(), hooks);
+        placePiece(piece_prom, move.to(), hooks);
 
         hash_key_ ^=
             Zobrist::piece(piece_pawn, move.from()) ^ Zobrist::piece(piece_prom, move.to());
@@ -2001,8 +2335,8 @@ inline void Board::makeMove(const Move &move) {
         assert(at(move.to()) == Piece::NONE);
         const auto piece = at(move.from());
 
-        removePiece(piece, move.from());
-        placePiece(piece, move.to());
+        removePiece(piece, move.from(), hooks);
+        placePiece(piece, move.to(), hooks);
 
         hash_key_ ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
     }
@@ -2012,7 +2346,7 @@ inline void Board::makeMove(const Move &move) {
 
         const auto piece = utils::makePiece(~side_to_move_, PieceType::PAWN);
 
-        removePiece(piece, Square(int(move.to()) ^ 8));
+        removePiece(piece, Square(int(move.to()) ^ 8), hooks);
 
         hash_key_ ^= Zobrist::piece(piece, Square(int(move.to()) ^ 8));
     }
@@ -2022,7 +2356,84 @@ inline void Board::makeMove(const Move &move) {
     side_to_move_ = ~side_to_move_;
 }
 
-inline void Board::unmakeMove(const Move &move) {
+inline U64 Board::hashAfter(const Move &move) const {
+    // Mirrors the hash updates of makeMove()
+    const auto captured = at(move.to());
+    const auto pt       = at<PieceType>(move.from());
+    auto castling       = castling_rights_;
+    U64 key             = hash_key_ ^ Zobrist::sideToMove();
+
+    if (enpassant_sq_ != NO_SQ) key ^= Zobrist::enpassant(utils::squareFile(enpassant_sq_));
+
+    if (captured != Piece::NONE && move.typeOf() != Move::CASTLING) {
+        key ^= Zobrist::piece(captured, move.to());
+
+        const auto rank = utils::squareRank(move.to());
+
+        if (utils::typeOfPiece(captured) == PieceType::ROOK &&
+            ((rank == Rank::RANK_1 && side_to_move_ == Color::BLACK) ||
+             (rank == Rank::RANK_8 && side_to_move_ == Color::WHITE))) {
+            const auto king_sq = kingSq(~side_to_move_);
+            const auto file = move.to() > king_sq ? CastleSide::KING_SIDE : CastleSide::QUEEN_SIDE;
+
+            if (castling.getRookFile(~side_to_move_, file) == utils::squareFile(move.to())) {
+                key ^= Zobrist::castlingIndex(castling.clearCastlingRight(~side_to_move_, file));
+            }
+        }
+    }
+
+    if (pt == PieceType::KING && castling.hasCastlingRight(side_to_move_)) {
+        key ^= Zobrist::castling(castling.getHashIndex());
+        castling.clearCastlingRight(side_to_move_);
+        key ^= Zobrist::castling(castling.getHashIndex());
+    } else if (pt == PieceType::ROOK && utils::ourBackRank(move.from(), side_to_move_)) {
+        const auto king_sq = kingSq(side_to_move_);
+        const auto file    = move.from() > king_sq ? CastleSide::KING_SIDE : CastleSide::QUEEN_SIDE;
+
+        if (castling.getRookFile(side_to_move_, file) == utils::squareFile(move.from())) {
+            key ^= Zobrist::castlingIndex(castling.clearCastlingRight(side_to_move_, file));
+        }
+    } else if (pt == PieceType::PAWN && std::abs(int(move.to()) - int(move.from())) == 16) {
+        const auto possible_ep = static_cast<Square>(move.to() ^ 8);
+
+        if (attacks::pawn(side_to_move_, possible_ep) & pieces(PieceType::PAWN, ~side_to_move_)) {
+            key ^= Zobrist::enpassant(utils::squareFile(possible_ep));
+        }
+    }
+
+    if (move.typeOf() == Move::CASTLING) {
+        const bool king_side = move.to() > move.from();
+        const auto rookTo =
+            utils::relativeSquare(side_to_move_, king_side ? Square::SQ_F1 : Square::SQ_D1);
+        const auto kingTo =
+            utils::relativeSquare(side_to_move_, king_side ? Square::SQ_G1 : Square::SQ_C1);
+        const auto king = at(move.from());
+        const auto rook = at(move.to());
+
+        key ^= Zobrist::piece(king, move.from()) ^ Zobrist::piece(king, kingTo);
+        key ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, rookTo);
+    } else if (move.typeOf() == Move::PROMOTION) {
+        const auto piece_pawn = utils::makePiece(side_to_move_, PieceType::PAWN);
+        const auto piece_prom = utils::makePiece(side_to_move_, move.promotionType());
+
+        key ^= Zobrist::piece(piece_pawn, move.from()) ^ Zobrist::piece(piece_prom, move.to());
+    } else {
+        const auto piece = at(move.from());
+
+        key ^= Zobrist::piece(piece, move.from()) ^ Zobrist::piece(piece, move.to());
+    }
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        const auto piece = utils::makePiece(~side_to_move_, PieceType::PAWN);
+
+        key ^= Zobrist::piece(piece, Square(int(move.to()) ^ 8));
+    }
+
+    return key;
+}
+
+template <typename Hooks>
+inline void Board::unmakeMove(const Move &move, Hooks &hooks) {
     const auto prev = prev_states_.back();
     prev_states_.pop_back();
 
@@ -2048,13 +2459,13 @@ inline void Board::unmakeMove(const Move &move) {
         const auto rook = at(rook_from_sq);
         const auto king = at(king_to_sq);
 
-        removePiece(rook, rook_from_sq);
-        removePiece(king, king_to_sq);
+        removePiece(rook, rook_from_sq, hooks);
+        removePiece(king, king_to_sq, hooks);
         assert(king == utils::makePiece(side_to_move_, PieceType::KING));
         assert(rook == utils::makePiece(side_to_move_, PieceType::ROOK));
 
-        placePiece(king, move.from());
-        placePiece(rook, move.to());
+        placePiece(king, move.from(), hooks);
+        placePiece(rook, move.to(), hooks);
 
         hash_key_ = prev.hash;
 
@@ -2067,12 +2478,12 @@ inline void Board::unmakeMove(const Move &move) {
         assert(utils::typeOfPiece(piece) != PieceType::KING);
         assert(utils::typeOfPiece(piece) != PieceType::NONE);
 
-        removePiece(piece, move.to());
-        placePiece(pawn, move.from());
+        removePiece(piece, move.to(), hooks);
+        placePiece(pawn, move.from(), hooks);
 
         if (prev.captured_piece != Piece::NONE) {
             assert(at(move.to()) == Piece::NONE);
-            placePiece(prev.captured_piece, move.to());
+            placePiece(prev.captured_piece, move.to(), hooks);
         }
 
         hash_key_ = prev.hash;
@@ -2083,8 +2494,8 @@ inline void Board::unmakeMove(const Move &move) {
         const auto piece = at(move.to());
         assert(at(move.from()) == Piece::NONE);
 
-        removePiece(piece, move.to());
-        placePiece(piece, move.from());
+        removePiece(piece, move.to(), hooks);
+        placePiece(piece, move.from(), hooks);
     }
 
     if (move.typeOf() == Move::ENPASSANT) {
@@ -2092,10 +2503,10 @@ inline void Board::unmakeMove(const Move &move) {
         const auto pawnTo = static_cast<Square>(enpassant_sq_ ^ 8);
 
         assert(at(pawnTo) == Piece::NONE);
-        placePiece(pawn, pawnTo);
+        placePiece(pawn, pawnTo, hooks);
     } else if (prev.captured_piece != Piece::NONE) {
         assert(at(move.to()) == Piece::NONE);
-        placePiece(prev.captured_piece, move.to());
+        placePiece(prev.captured_piece, move.to(), hooks);
     }
 
     hash_key_ = prev.hash;
@@ -2129,95 +2540,481 @@ inline void Board::unmakeNullMove() {
 }
 
 /****************************************************************************\
- * attacks Implementations                                                     *
+ * Position                                                                  *
 \****************************************************************************/
 
-/// @brief Shifts a bitboard in a given direction
-/// @tparam direction
-/// @param b
-/// @return
-template <Direction direction>
-[[nodiscard]] inline constexpr Bitboard attacks::shift(const Bitboard b) {
-    switch (direction) {
-        case Direction::NORTH:
-            return b << 8;
-        case Direction::SOUTH:
-            return b >> 8;
-        case Direction::NORTH_WEST:
-            return (b & ~MASK_FILE[0]) << 7;
-        case Direction::WEST:
-            return (b & ~MASK_FILE[0]) >> 1;
-        case Direction::SOUTH_WEST:
-            return (b & ~MASK_FILE[0]) >> 9;
-        case Direction::NORTH_EAST:
-            return (b & ~MASK_FILE[7]) << 9;
-        case Direction::EAST:
-            return (b & ~MASK_FILE[7]) << 1;
-        case Direction::SOUTH_EAST:
-            return (b & ~MASK_FILE[7]) >> 7;
-    }
-}
+/// @brief Compact, trivially copyable position for copy-make search. Everything fits into one
+/// cache line: color and piece type bitboards, with queens stored in both slider sets, the
+/// king squares and the packed state. There is no move history, so a copy is a plain 64 byte
+/// copy and threads can share positions freely; repetitions have to be tracked by the caller.
+struct alignas(64) Position {
+   public:
+    Position() = default;
 
-/// @brief [Internal Usage] Generate the left side pawn attacks.
-/// @tparam c
-/// @param pawns
-/// @return
-template <Color c>
-[[nodiscard]] inline Bitboard attacks::pawnLeftAttacks(const Bitboard pawns) {
-    return c == Color::WHITE ? (pawns << 7) & ~MASK_FILE[static_cast<int>(File::FILE_H)]
-                             : (pawns >> 7) & ~MASK_FILE[static_cast<int>(File::FILE_A)];
-}
+    /// @brief Converts a board, its move history is dropped.
+    /// @param board
+    explicit Position(const Board &board);
 
-/// @brief [Internal Usage] Generate the right side pawn attacks.
-/// @tparam c
-/// @param pawns
-/// @return
-template <Color c>
-[[nodiscard]] inline Bitboard attacks::pawnRightAttacks(const Bitboard pawns) {
-    return c == Color::WHITE ? (pawns << 9) & ~MASK_FILE[static_cast<int>(File::FILE_A)]
-                             : (pawns >> 9) & ~MASK_FILE[static_cast<int>(File::FILE_H)];
-}
+    /// @brief Converts back to a board without move history.
+    /// @return
+    [[nodiscard]] Board toBoard() const;
 
-/// @brief Returns the pawn attacks for a given color and square
-/// @param c
-/// @param sq
-/// @return
-[[nodiscard]] inline Bitboard attacks::pawn(Color c, Square sq) { return PawnAttacks[int(c)][sq]; }
+    /// @brief Get the FEN string. The full move number is not stored and always 1.
+    /// @return
+    [[nodiscard]] std::string getFen() const;
 
-/// @brief Returns the knight attacks for a given square
-/// @param sq
-/// @return
-[[nodiscard]] inline Bitboard attacks::knight(Square sq) { return KnightAttacks[sq]; }
+    /// @brief Writes the position after the move into child, usually a preallocated slot of a
+    /// per ply array. The move must be legal in this position.
+    /// @param move
+    /// @param child
+    void apply(const Move &move, Position &child) const;
 
-/// @brief Returns the bishop attacks for a given square
-/// @param sq
-/// @param occupied
-/// @return
-[[nodiscard]] inline Bitboard attacks::bishop(Square sq, Bitboard occupied) {
-    return BishopTable[sq].attacks[BishopTable[sq](occupied)];
-}
+    [[nodiscard]] Piece at(Square sq) const;
+    [[nodiscard]] Bitboard pieces(PieceType type, Color color) const;
+    [[nodiscard]] Bitboard us(Color color) const { return colors_[static_cast<int>(color)]; }
+    [[nodiscard]] Bitboard occ() const { return colors_[0] | colors_[1]; }
+    [[nodiscard]] Square kingSq(Color color) const {
+        return Square(kings_[static_cast<int>(color)]);
+    }
 
-/// @brief Returns the rook attacks for a given square
-/// @param sq
-/// @param occupied
-/// @return
-[[nodiscard]] inline Bitboard attacks::rook(Square sq, Bitboard occupied) {
-    return RookTable[sq].attacks[RookTable[sq](occupied)];
-}
+    [[nodiscard]] U64 hash() const { return hash_; }
+    [[nodiscard]] Color sideToMove() const { return Color(side_to_move_); }
+    [[nodiscard]] Square enpassantSq() const { return Square(enpassant_); }
+    [[nodiscard]] int halfMoveClock() const { return half_moves_; }
 
-/// @brief Returns the queen attacks for a given square
-/// @param sq
-/// @param occupied
-/// @return
-[[nodiscard]] inline Bitboard attacks::queen(Square sq, Bitboard occupied) {
-    return bishop(sq, occupied) | rook(sq, occupied);
-}
+   private:
+    template <typename B>
+    friend void movegen::legalTargetLanes(const Position *positions, movegen::LegalTargets *targets);
 
-/// @brief Returns the king attacks for a given square
-/// @param sq
+    void placePiece(Piece piece, Square sq);
+    void removePiece(Piece piece, Square sq);
+
+    /// @brief Castling rights are stored like in Board: the rook file + 1 in four 4 bit
+    /// groups, white king side, white queen side, black king side, black queen side.
+    [[nodiscard]] File rookFile(Color color, CastleSide side) const {
+        return File(((castling_ >> (4 * group(color, side))) & 0xF) - 1);
+    }
+    [[nodiscard]] bool standardCastling(Color color, CastleSide side) const {
+        return utils::squareFile(kingSq(color)) == File::FILE_E &&
+               rookFile(color, side) ==
+                   (side == CastleSide::KING_SIDE ? File::FILE_H : File::FILE_A);
+    }
+    [[nodiscard]] int castlingHashIndex() const;
+    static int group(Color color, CastleSide side) {
+        return 2 * static_cast<int>(color) + static_cast<int>(side);
+    }
+
+    Bitboard colors_[2];
+    Bitboard pawns_;
+    Bitboard knights_;
+    Bitboard diagonal_;    // Bishops and queens
+    Bitboard orthogonal_;  // Rooks and queens
+    U64 hash_;
+    uint16_t castling_;
+    uint8_t kings_[2];
+    uint8_t enpassant_;
+    uint8_t side_to_move_;
+    uint8_t half_moves_;
+};
+
+static_assert(sizeof(Position) == 64, "Position should fill one cache line");
+static_assert(std::is_trivially_copyable_v<Position>, "Position is copied with memcpy");
+
+inline Position::Position(const Board &board) {
+    colors_[0] = colors_[1] = pawns_ = knights_ = diagonal_ = orthogonal_ = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (board.at(Square(sq)) != Piece::NONE) placePiece(board.at(Square(sq)), Square(sq));
+    }
+
+    const auto rights = board.castlingRights();
+    castling_         = 0;
+    for (const auto color : {Color::WHITE, Color::BLACK}) {
+        for (const auto side : {CastleSide::KING_SIDE, CastleSide::QUEEN_SIDE}) {
+            if (rights.hasCastlingRight(color, side)) {
+                castling_ |= (int(rights.getRookFile(color, side)) + 1) << (4 * group(color, side));
+            }
+        }
+    }
+
+    hash_         = board.hash();
+    enpassant_    = board.enpassantSq();
+    side_to_move_ = static_cast<uint8_t>(board.sideToMove());
+    half_moves_   = static_cast<uint8_t>(board.halfMoveClock());
+}
+
+inline std::string Position::getFen() const {
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            const auto piece = at(Square(rank * 8 + file));
+            if (piece == Piece::NONE) {
+                empty++;
+                continue;
+            }
+            if (empty) fen += char('0' + empty);
+            empty = 0;
+            fen += "PNBRQKpnbrqk"[static_cast<int>(piece)];
+        }
+        if (empty) fen += char('0' + empty);
+        if (rank) fen += '/';
+    }
+
+    fen += sideToMove() == Color::WHITE ? " w " : " b ";
+
+    // Standard letters where possible, the rook file otherwise (Shredder-FEN)
+    const std::size_t castling_start = fen.size();
+    for (const auto color : {Color::WHITE, Color::BLACK}) {
+        for (const auto side : {CastleSide::KING_SIDE, CastleSide::QUEEN_SIDE}) {
+            const auto file = rookFile(color, side);
+            if (file == File::NO_FILE) continue;
+
+            char letter = standardCastling(color, side)
+                              ? (side == CastleSide::KING_SIDE ? 'K' : 'Q')
+                              : char('A' + static_cast<int>(file));
+            fen += color == Color::WHITE ? letter : char(letter + ('a' - 'A'));
+        }
+    }
+    if (fen.size() == castling_start) fen += '-';
+
+    fen += ' ';
+    fen += enpassant_ == NO_SQ ? std::string("-") : std::string(squareToString[enpassant_]);
+    fen += " " + std::to_string(half_moves_) + " 1";
+    return fen;
+}
+
+inline Board Position::toBoard() const {
+    Board board;
+    for (const auto color : {Color::WHITE, Color::BLACK}) {
+        for (const auto side : {CastleSide::KING_SIDE, CastleSide::QUEEN_SIDE}) {
+            // Only a chess960 board understands rook file letters
+            if (rookFile(color, side) != File::NO_FILE && !standardCastling(color, side)) {
+                board.set960(true);
+            }
+        }
+    }
+    board.setFen(getFen());
+    return board;
+}
+
+inline Piece Position::at(Square sq) const {
+    const Bitboard bb = 1ULL << sq;
+    if (!(occ() & bb)) return Piece::NONE;
+
+    const auto color = (colors_[0] & bb) ? Color::WHITE : Color::BLACK;
+    PieceType type   = PieceType::KING;
+    if (pawns_ & bb)
+        type = PieceType::PAWN;
+    else if (knights_ & bb)
+        type = PieceType::KNIGHT;
+    else if (diagonal_ & orthogonal_ & bb)
+        type = PieceType::QUEEN;
+    else if (diagonal_ & bb)
+        type = PieceType::BISHOP;
+    else if (orthogonal_ & bb)
+        type = PieceType::ROOK;
+    return utils::makePiece(color, type);
+}
+
+inline Bitboard Position::pieces(PieceType type, Color color) const {
+    switch (type) {
+        case PieceType::PAWN:
+            return pawns_ & us(color);
+        case PieceType::KNIGHT:
+            return knights_ & us(color);
+        case PieceType::BISHOP:
+            return diagonal_ & ~orthogonal_ & us(color);
+        case PieceType::ROOK:
+            return orthogonal_ & ~diagonal_ & us(color);
+        case PieceType::QUEEN:
+            return diagonal_ & orthogonal_ & us(color);
+        case PieceType::KING:
+            return 1ULL << kings_[static_cast<int>(color)];
+        default:
+            return 0;
+    }
+}
+
+inline void Position::placePiece(Piece piece, Square sq) {
+    const Bitboard bb = 1ULL << sq;
+    colors_[static_cast<int>(Board::color(piece))] |= bb;
+    switch (utils::typeOfPiece(piece)) {
+        case PieceType::PAWN:
+            pawns_ |= bb;
+            break;
+        case PieceType::KNIGHT:
+            knights_ |= bb;
+            break;
+        case PieceType::BISHOP:
+            diagonal_ |= bb;
+            break;
+        case PieceType::ROOK:
+            orthogonal_ |= bb;
+            break;
+        case PieceType::QUEEN:
+            diagonal_ |= bb;
+            orthogonal_ |= bb;
+            break;
+        default:
+            kings_[static_cast<int>(Board::color(piece))] = sq;
+    }
+}
+
+inline void Position::removePiece(Piece piece, Square sq) {
+    const Bitboard bb = ~(1ULL << sq);
+    colors_[static_cast<int>(Board::color(piece))] &= bb;
+    pawns_ &= bb;
+    knights_ &= bb;
+    diagonal_ &= bb;
+    orthogonal_ &= bb;
+}
+
+inline int Position::castlingHashIndex() const {
+    int index = 0;
+    for (int i = 0; i < 4; i++) {
+        index |= (((castling_ >> (4 * i)) & 0xF) != 0) << i;
+    }
+    return index;
+}
+
+inline void Position::apply(const Move &move, Position &child) const {
+    // Same rules and hash updates as Board::makeMove()
+    const auto stm      = sideToMove();
+    const auto captured = at(move.to());
+    const auto moving   = at(move.from());
+    const auto pt       = utils::typeOfPiece(moving);
+
+    child = *this;
+    child.half_moves_++;
+    child.hash_ ^= Zobrist::sideToMove();
+    child.side_to_move_ ^= 1;
+
+    if (enpassant_ != NO_SQ) child.hash_ ^= Zobrist::enpassant(utils::squareFile(enpassantSq()));
+    child.enpassant_ = NO_SQ;
+
+    const int castling_index = castlingHashIndex();
+
+    if (captured != Piece::NONE && move.typeOf() != Move::CASTLING) {
+        child.half_moves_ = 0;
+        child.removePiece(captured, move.to());
+        child.hash_ ^= Zobrist::piece(captured, move.to());
+
+        const auto rank = utils::squareRank(move.to());
+        if (utils::typeOfPiece(captured) == PieceType::ROOK &&
+            ((rank == Rank::RANK_1 && stm == Color::BLACK) ||
+             (rank == Rank::RANK_8 && stm == Color::WHITE))) {
+            const auto side = move.to() > kingSq(~stm) ? CastleSide::KING_SIDE
+                                                       : CastleSide::QUEEN_SIDE;
+            if (rookFile(~stm, side) == utils::squareFile(move.to())) {
+                child.castling_ &= ~(0xF << (4 * group(~stm, side)));
+            }
+        }
+    }
+
+    if (pt == PieceType::KING) {
+        child.castling_ &= ~(0xFF << (4 * group(stm, CastleSide::KING_SIDE)));
+    } else if (pt == PieceType::ROOK && utils::ourBackRank(move.from(), stm)) {
+        const auto side =
+            move.from() > kingSq(stm) ? CastleSide::KING_SIDE : CastleSide::QUEEN_SIDE;
+        if (rookFile(stm, side) == utils::squareFile(move.from())) {
+            child.castling_ &= ~(0xF << (4 * group(stm, side)));
+        }
+    } else if (pt == PieceType::PAWN) {
+        child.half_moves_ = 0;
+
+        const auto possible_ep = static_cast<Square>(move.to() ^ 8);
+        if (std::abs(int(move.to()) - int(move.from())) == 16 &&
+            (attacks::pawn(stm, possible_ep) & pieces(PieceType::PAWN, ~stm))) {
+            child.enpassant_ = possible_ep;
+            child.hash_ ^= Zobrist::enpassant(utils::squareFile(possible_ep));
+        }
+    }
+
+    child.hash_ ^= Zobrist::castling(castling_index) ^ Zobrist::castling(child.castlingHashIndex());
+
+    if (move.typeOf() == Move::CASTLING) {
+        const bool king_side = move.to() > move.from();
+        const auto rook_to =
+            utils::relativeSquare(stm, king_side ? Square::SQ_F1 : Square::SQ_D1);
+        const auto king_to =
+            utils::relativeSquare(stm, king_side ? Square::SQ_G1 : Square::SQ_C1);
+        const auto rook = utils::makePiece(stm, PieceType::ROOK);
+
+        child.removePiece(moving, move.from());
+        child.removePiece(rook, move.to());
+        child.placePiece(moving, king_to);
+        child.placePiece(rook, rook_to);
+        child.hash_ ^= Zobrist::piece(moving, move.from()) ^ Zobrist::piece(moving, king_to);
+        child.hash_ ^= Zobrist::piece(rook, move.to()) ^ Zobrist::piece(rook, rook_to);
+        return;
+    }
+
+    const auto placed = move.typeOf() == Move::PROMOTION
+                            ? utils::makePiece(stm, move.promotionType())
+                            : moving;
+    child.removePiece(moving, move.from());
+    child.placePiece(placed, move.to());
+    child.hash_ ^= Zobrist::piece(moving, move.from()) ^ Zobrist::piece(placed, move.to());
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        const auto pawn = utils::makePiece(~stm, PieceType::PAWN);
+        const auto sq   = Square(int(move.to()) ^ 8);
+        child.removePiece(pawn, sq);
+        child.hash_ ^= Zobrist::piece(pawn, sq);
+    }
+}
+
+/****************************************************************************\
+ * attacks Implementations                                                     *
+\****************************************************************************/
+
+/// @brief Shifts a bitboard in a given direction
+/// @tparam direction
+/// @param b
+/// @return
+/// @tparam B Bitboard or a vector of bitboards, see movegen::BatchLanes
+template <Direction direction, typename B>
+[[nodiscard]] inline constexpr B attacks::shift(const B b) {
+    switch (direction) {
+        case Direction::NORTH:
+            return b << 8;
+        case Direction::SOUTH:
+            return b >> 8;
+        case Direction::NORTH_WEST:
+            return (b & ~MASK_FILE[0]) << 7;
+        case Direction::WEST:
+            return (b & ~MASK_FILE[0]) >> 1;
+        case Direction::SOUTH_WEST:
+            return (b & ~MASK_FILE[0]) >> 9;
+        case Direction::NORTH_EAST:
+            return (b & ~MASK_FILE[7]) << 9;
+        case Direction::EAST:
+            return (b & ~MASK_FILE[7]) << 1;
+        case Direction::SOUTH_EAST:
+            return (b & ~MASK_FILE[7]) >> 7;
+    }
+}
+
+/// @brief [Internal Usage] Generate the left side pawn attacks.
+/// @tparam c
+/// @param pawns
+/// @return
+template <Color c>
+[[nodiscard]] inline Bitboard attacks::pawnLeftAttacks(const Bitboard pawns) {
+    return c == Color::WHITE ? (pawns << 7) & ~MASK_FILE[static_cast<int>(File::FILE_H)]
+                             : (pawns >> 7) & ~MASK_FILE[static_cast<int>(File::FILE_A)];
+}
+
+/// @brief [Internal Usage] Generate the right side pawn attacks.
+/// @tparam c
+/// @param pawns
+/// @return
+template <Color c>
+[[nodiscard]] inline Bitboard attacks::pawnRightAttacks(const Bitboard pawns) {
+    return c == Color::WHITE ? (pawns << 9) & ~MASK_FILE[static_cast<int>(File::FILE_A)]
+                             : (pawns >> 9) & ~MASK_FILE[static_cast<int>(File::FILE_H)];
+}
+
+/// @brief Returns the pawn attacks for a given color and square
+/// @param c
+/// @param sq
+/// @return
+[[nodiscard]] inline Bitboard attacks::pawn(Color c, Square sq) { return PawnAttacks[int(c)][sq]; }
+
+/// @brief Returns the knight attacks for a given square
+/// @param sq
+/// @return
+[[nodiscard]] inline Bitboard attacks::knight(Square sq) { return KnightAttacks[sq]; }
+
+/// @brief Returns the bishop attacks for a given square
+/// @param sq
+/// @param occupied
+/// @return
+[[nodiscard]] inline Bitboard attacks::bishop(Square sq, Bitboard occupied) {
+    return BishopTable[sq].attacks[BishopTable[sq](occupied)];
+}
+
+/// @brief Returns the rook attacks for a given square
+/// @param sq
+/// @param occupied
+/// @return
+[[nodiscard]] inline Bitboard attacks::rook(Square sq, Bitboard occupied) {
+    return RookTable[sq].attacks[RookTable[sq](occupied)];
+}
+
+/// @brief Returns the queen attacks for a given square
+/// @param sq
+/// @param occupied
+/// @return
+[[nodiscard]] inline Bitboard attacks::queen(Square sq, Bitboard occupied) {
+    return bishop(sq, occupied) | rook(sq, occupied);
+}
+
+/// @brief Returns the king attacks for a given square
+/// @param sq
 /// @return
 [[nodiscard]] inline Bitboard attacks::king(Square sq) { return KingAttacks[sq]; }
 
+template <Direction direction, typename B>
+[[nodiscard]] inline constexpr B attacks::slide(B sliders, B occupied) {
+    constexpr int delta = static_cast<int>(direction);
+
+    // Squares a ray may pass, without those it would reach by wrapping around the board
+    constexpr Bitboard wrap = (delta == 1 || delta == 9 || delta == -7)    ? ~MASK_FILE[0]
+                              : (delta == -1 || delta == 7 || delta == -9) ? ~MASK_FILE[7]
+                                                                           : ~0ULL;
+
+    auto step = [](B b, int n) {
+        if constexpr (delta > 0)
+            return b << (delta * n);
+        else
+            return b >> (-delta * n);
+    };
+
+    // Every round doubles the distance the rays have travelled
+    B empty = ~occupied & wrap;
+    sliders |= empty & step(sliders, 1);
+    empty &= step(empty, 1);
+    sliders |= empty & step(sliders, 2);
+    empty &= step(empty, 2);
+    sliders |= empty & step(sliders, 4);
+    return shift<direction>(sliders);
+}
+
+template <typename B>
+[[nodiscard]] inline constexpr B attacks::knightSet(B knights) {
+    const B one = ((knights << 1) & ~MASK_FILE[0]) | ((knights >> 1) & ~MASK_FILE[7]);
+    const B two = ((knights << 2) & ~(MASK_FILE[0] | MASK_FILE[1])) |
+                  ((knights >> 2) & ~(MASK_FILE[6] | MASK_FILE[7]));
+    return (one << 16) | (one >> 16) | (two << 8) | (two >> 8);
+}
+
+template <typename B>
+[[nodiscard]] inline constexpr B attacks::bishopSet(B bishops, B occupied) {
+    return slide<Direction::NORTH_EAST>(bishops, occupied) |
+           slide<Direction::NORTH_WEST>(bishops, occupied) |
+           slide<Direction::SOUTH_EAST>(bishops, occupied) |
+           slide<Direction::SOUTH_WEST>(bishops, occupied);
+}
+
+template <typename B>
+[[nodiscard]] inline constexpr B attacks::rookSet(B rooks, B occupied) {
+    return slide<Direction::NORTH>(rooks, occupied) | slide<Direction::SOUTH>(rooks, occupied) |
+           slide<Direction::EAST>(rooks, occupied) | slide<Direction::WEST>(rooks, occupied);
+}
+
+template <typename B>
+[[nodiscard]] inline constexpr B attacks::queenSet(B queens, B occupied) {
+    return bishopSet(queens, occupied) | rookSet(queens, occupied);
+}
+
+template <typename B>
+[[nodiscard]] inline constexpr B attacks::kingSet(B kings) {
+    const B sides = shift<Direction::EAST>(kings) | shift<Direction::WEST>(kings);
+    const B row   = kings | sides;
+    return sides | shift<Direction::NORTH>(row) | shift<Direction::SOUTH>(row);
+}
+
 /// @brief Returns a bitboard with the origin squares of the attacking pieces set
 /// @param board
 /// @param color Attacker Color
@@ -2326,7 +3123,7 @@ template <Color c>
 /// @param magic
 /// @param attacks
 inline void attacks::initSliders(Square sq, Magic table[], U64 magic,
-                                 const std::function<Bitboard(Square, Bitboard)> &attacks) {
+                                 Bitboard (*attacks)(Square, Bitboard)) {
     const Bitboard edges =
         ((MASK_RANK[static_cast<int>(Rank::RANK_1)] | MASK_RANK[static_cast<int>(Rank::RANK_8)]) &
          ~MASK_RANK[static_cast<int>(utils::squareRank(sq))]) |
@@ -2361,7 +3158,9 @@ inline void attacks::initAttacks() {
     }
 }
 
-static auto init = []() {
+// An inline variable has one definition for the whole program, so the tables are built
+// once per process rather than once for every translation unit including this header
+inline const auto init = []() {
     attacks::initAttacks();
     return 0;
 }();
@@ -2372,32 +3171,26 @@ static auto init = []() {
 
 namespace movegen {
 
-// force initialization of squares between
-static auto init_squares_between = []() constexpr {
-    // initialize squares between table
+// Squares between two squares on a common line, empty otherwise. Computed at compile time
+// with a walk from one square to the other, so it needs no startup work.
+inline constexpr auto SQUARES_BETWEEN_BB = []() constexpr {
     std::array<std::array<U64, constants::MAX_SQ>, constants::MAX_SQ> squares_between_bb{};
-    U64 sqs = 0;
 
     for (int sq1 = 0; sq1 < constants::MAX_SQ; ++sq1) {
         for (int sq2 = 0; sq2 < constants::MAX_SQ; ++sq2) {
-            sqs = (1ULL << sq1) | (1ULL << sq2);
-            if (sq1 == sq2)
-                squares_between_bb[sq1][sq2] = 0ull;
-            else if (utils::squareFile(Square(sq1)) == utils::squareFile(Square(sq2)) ||
-                     utils::squareRank(Square(sq1)) == utils::squareRank(Square(sq2)))
-                squares_between_bb[sq1][sq2] =
-                    attacks::rook(Square(sq1), sqs) & attacks::rook(Square(sq2), sqs);
-            else if (utils::diagonalOf(Square(sq1)) == utils::diagonalOf(Square(sq2)) ||
-                     utils::antiDiagonalOf(Square(sq1)) == utils::antiDiagonalOf(Square(sq2)))
-                squares_between_bb[sq1][sq2] =
-                    attacks::bishop(Square(sq1), sqs) & attacks::bishop(Square(sq2), sqs);
+            const int dr = sq2 / 8 - sq1 / 8;
+            const int df = sq2 % 8 - sq1 % 8;
+            if (sq1 == sq2 || (dr && df && dr != df && dr != -df)) continue;
+
+            const int delta = 8 * ((dr > 0) - (dr < 0)) + (df > 0) - (df < 0);
+            for (int sq = sq1 + delta; sq != sq2; sq += delta) {
+                squares_between_bb[sq1][sq2] |= 1ULL << sq;
+            }
         }
     }
 
     return squares_between_bb;
-};
-
-static const std::array<std::array<U64, 64>, 64> SQUARES_BETWEEN_BB = init_squares_between();
+}();
 
 /// @brief [Internal Usage] Generate the checkmask.
 /// Returns a bitboard where the attacker path between the king and enemy piece is set.
@@ -2563,6 +3356,146 @@ template <Color c>
     return seen;
 }
 
+/// @brief [Internal Usage] Fills the checkers, check mask and pins of an AttackInfo, which is
+/// everything legal move generation needs besides the king danger squares.
+/// @tparam c
+/// @param board
+/// @param info
+template <Color c>
+void kingSafety(const Board &board, AttackInfo &info) {
+    const auto king_sq   = board.kingSq(c);
+    const auto occ_us    = board.us(c);
+    const auto occ_enemy = board.us(~c);
+
+    info.checkers = attacks::attackers(board, ~c, king_sq, board.occ());
+
+    if (!info.checkers)
+        info.check_mask = constants::DEFAULT_CHECKMASK;
+    else if (info.checkers & (info.checkers - 1))
+        info.check_mask = 0;  // Double check, only the king can move
+    else
+        info.check_mask = SQUARES_BETWEEN_BB[king_sq][builtin::lsb(info.checkers)] | info.checkers;
+
+    info.pin_hv = pinMaskRooks<c>(board, king_sq, occ_enemy, occ_us);
+    info.pin_d  = pinMaskBishops<c>(board, king_sq, occ_enemy, occ_us);
+    info.pinned = (info.pin_hv | info.pin_d) & occ_us;
+}
+
+/// @brief [Internal Usage] Fills the attacked squares of one color of an AttackInfo.
+/// @tparam c
+/// @param board
+/// @param info
+template <Color c>
+void attackedBy(const Board &board, AttackInfo &info) {
+    const auto occ   = board.occ();
+    const auto pawns = board.pieces(PieceType::PAWN, c);
+    auto &attacked   = info.attacked_by[static_cast<int>(c)];
+
+    attacked[static_cast<int>(PieceType::PAWN)] =
+        attacks::pawnLeftAttacks<c>(pawns) | attacks::pawnRightAttacks<c>(pawns);
+    attacked[static_cast<int>(PieceType::KNIGHT)] =
+        attacks::knightSet(board.pieces(PieceType::KNIGHT, c));
+    attacked[static_cast<int>(PieceType::KING)] = attacks::king(board.kingSq(c));
+
+    // Sliders are few, a lookup per piece beats filling all directions
+    auto slider = [&](PieceType pt, auto lookup) {
+        Bitboard pieces = board.pieces(pt, c);
+        Bitboard result = 0;
+        while (pieces) result |= lookup(builtin::poplsb(pieces), occ);
+        attacked[static_cast<int>(pt)] = result;
+    };
+
+    slider(PieceType::BISHOP, attacks::bishop);
+    slider(PieceType::ROOK, attacks::rook);
+    slider(PieceType::QUEEN, attacks::queen);
+
+    info.attacked[static_cast<int>(c)] = 0;
+    for (const Bitboard squares : attacked) info.attacked[static_cast<int>(c)] |= squares;
+}
+
+/// @brief [Internal Usage] Computes the complete AttackInfo of a position.
+/// @tparam c Side to move
+/// @param board
+/// @return
+template <Color c>
+[[nodiscard]] AttackInfo attackInfo(const Board &board) {
+    AttackInfo info;
+
+    kingSafety<c>(board, info);
+    attackedBy<Color::WHITE>(board, info);
+    attackedBy<Color::BLACK>(board, info);
+
+    // The king only hides squares from the sliders checking it
+    const auto king_sq = board.kingSq(c);
+    const auto occ     = board.occ() ^ (1ULL << king_sq);
+
+    info.king_danger = info.attacked[static_cast<int>(~c)];
+
+    Bitboard sliders =
+        info.checkers & ~(board.pieces(PieceType::PAWN) | board.pieces(PieceType::KNIGHT));
+    while (sliders) {
+        const auto sq = builtin::poplsb(sliders);
+        const auto pt = board.at<PieceType>(sq);
+        if (pt == PieceType::BISHOP || pt == PieceType::QUEEN)
+            info.king_danger |= attacks::bishop(sq, occ);
+        if (pt == PieceType::ROOK || pt == PieceType::QUEEN)
+            info.king_danger |= attacks::rook(sq, occ);
+    }
+
+    info.check_info = board.checkInfo();
+
+    return info;
+}
+
+/// @brief [Internal Usage] Stands in for a Movelist when only the number of moves is needed.
+struct MoveCounter {
+    int count = 0;
+
+    void add(const Move &) { count++; }
+};
+
+/// @brief [Internal Usage] Adds a normal move to every target square, from the square the
+/// given steps away.
+/// @tparam List
+/// @tparam Steps
+/// @param moves
+/// @param targets
+/// @param steps
+template <typename List, typename... Steps>
+inline void addShifted(List &moves, Bitboard targets, Steps... steps) {
+    if constexpr (std::is_same_v<List, MoveCounter>) {
+        moves.count += builtin::popcount(targets);
+    } else {
+        while (targets) {
+            const auto index = builtin::poplsb(targets);
+            moves.add(Move::make<Move::NORMAL>((index + ... + steps), index));
+        }
+    }
+}
+
+/// @brief [Internal Usage] Adds the promotions to every target square, from the square one
+/// step away.
+/// @tparam underpromotions if false only queen promotions are added
+/// @tparam List
+/// @param moves
+/// @param targets
+/// @param step
+template <bool underpromotions, typename List>
+inline void addPromotions(List &moves, Bitboard targets, Direction step) {
+    if constexpr (std::is_same_v<List, MoveCounter>) {
+        moves.count += builtin::popcount(targets) * (underpromotions ? 4 : 1);
+    } else {
+        while (targets) {
+            const auto index = builtin::poplsb(targets);
+            moves.add(Move::make<Move::PROMOTION>(index + step, index, PieceType::QUEEN));
+            if (!underpromotions) continue;
+            moves.add(Move::make<Move::PROMOTION>(index + step, index, PieceType::ROOK));
+            moves.add(Move::make<Move::PROMOTION>(index + step, index, PieceType::BISHOP));
+            moves.add(Move::make<Move::PROMOTION>(index + step, index, PieceType::KNIGHT));
+        }
+    }
+}
+
 /// @brief [Internal Usage] Generate pawn moves.
 /// @tparam c
 /// @tparam mt
@@ -2572,8 +3505,8 @@ template <Color c>
 /// @param pin_hv
 /// @param checkmask
 /// @param occ_enemy
-template <Color c, MoveGenType mt>
-void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitboard pin_hv,
+template <Color c, MoveGenType mt, typename List>
+void generatePawnMoves(const Board &board, List &moves, Bitboard pin_d, Bitboard pin_hv,
                        Bitboard checkmask, Bitboard occ_enemy) {
     const auto pawns = board.pieces(PieceType::PAWN, c);
 
@@ -2594,6 +3527,10 @@ void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitb
                                               ? attacks::MASK_RANK[static_cast<int>(Rank::RANK_3)]
                                               : attacks::MASK_RANK[static_cast<int>(Rank::RANK_6)];
 
+    constexpr bool CAPTURES    = mt != MoveGenType::QUIET && mt != MoveGenType::QUIET_CHECK;
+    constexpr bool PUSHES      = mt != MoveGenType::CAPTURE && mt != MoveGenType::NOISY;
+    constexpr bool UNDERPROMOS = mt != MoveGenType::NOISY;
+
     // These pawns can maybe take Left or Right
     const Bitboard pawns_lr = pawns & ~pin_hv;
 
@@ -2628,39 +3565,34 @@ void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitb
          (attacks::shift<UP>(single_push_pinned & DOUBLE_PUSH_RANK) & ~board.occ())) &
         checkmask;
 
-    if (pawns & RANK_B_PROMO) {
+    if constexpr (mt == MoveGenType::QUIET_CHECK) {
+        // Pushes onto a checking square, or of a pawn uncovering a slider which is not on
+        // the file of the king
+        const CheckInfo info    = board.checkInfo();
+        const Bitboard checking = info.check_squares[static_cast<int>(PieceType::PAWN)];
+        const Bitboard discovering =
+            attacks::shift<UP>(pawns & info.discoverers &
+                               ~attacks::MASK_FILE[static_cast<int>(utils::squareFile(info.king_sq))]);
+
+        single_push &= checking | discovering;
+        double_push &= checking | attacks::shift<UP>(discovering);
+    }
+
+    if (mt != MoveGenType::QUIET_CHECK && (pawns & RANK_B_PROMO)) {
         Bitboard promo_left  = l_pawns & RANK_PROMO;
         Bitboard promo_right = r_pawns & RANK_PROMO;
         Bitboard promo_push  = single_push & RANK_PROMO;
 
         // Skip capturing promotions if we are only generating quiet moves.
-        // Generates at ALL and CAPTURE
-        while (mt != MoveGenType::QUIET && promo_left) {
-            const auto index = builtin::poplsb(promo_left);
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_RIGHT, index, PieceType::QUEEN));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_RIGHT, index, PieceType::ROOK));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_RIGHT, index, PieceType::BISHOP));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_RIGHT, index, PieceType::KNIGHT));
-        }
-
-        // Skip capturing promotions if we are only generating quiet moves.
-        // Generates at ALL and CAPTURE
-        while (mt != MoveGenType::QUIET && promo_right) {
-            const auto index = builtin::poplsb(promo_right);
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_LEFT, index, PieceType::QUEEN));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_LEFT, index, PieceType::ROOK));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_LEFT, index, PieceType::BISHOP));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN_LEFT, index, PieceType::KNIGHT));
+        if (CAPTURES) {
+            addPromotions<UNDERPROMOS>(moves, promo_left, DOWN_RIGHT);
+            addPromotions<UNDERPROMOS>(moves, promo_right, DOWN_LEFT);
         }
 
-        // Skip quiet promotions if we are only generating captures.
-        // Generates at ALL and QUIET
-        while (mt != MoveGenType::CAPTURE && promo_push) {
-            const auto index = builtin::poplsb(promo_push);
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN, index, PieceType::QUEEN));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN, index, PieceType::ROOK));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN, index, PieceType::BISHOP));
-            moves.add(Move::make<Move::PROMOTION>(index + DOWN, index, PieceType::KNIGHT));
+        // Skip quiet promotions if we are only generating captures, NOISY still wants the
+        // queen promotion
+        if (PUSHES || mt == MoveGenType::NOISY) {
+            addPromotions<UNDERPROMOS>(moves, promo_push, DOWN);
         }
     }
 
@@ -2668,28 +3600,18 @@ void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitb
     l_pawns &= ~RANK_PROMO;
     r_pawns &= ~RANK_PROMO;
 
-    while (mt != MoveGenType::QUIET && l_pawns) {
-        const auto index = builtin::poplsb(l_pawns);
-        moves.add(Move::make<Move::NORMAL>(index + DOWN_RIGHT, index));
-    }
-
-    while (mt != MoveGenType::QUIET && r_pawns) {
-        const auto index = builtin::poplsb(r_pawns);
-        moves.add(Move::make<Move::NORMAL>(index + DOWN_LEFT, index));
-    }
-
-    while (mt != MoveGenType::CAPTURE && single_push) {
-        const auto index = builtin::poplsb(single_push);
-        moves.add(Move::make<Move::NORMAL>(index + DOWN, index));
+    if (CAPTURES) {
+        addShifted(moves, l_pawns, DOWN_RIGHT);
+        addShifted(moves, r_pawns, DOWN_LEFT);
     }
 
-    while (mt != MoveGenType::CAPTURE && double_push) {
-        const auto index = builtin::poplsb(double_push);
-        moves.add(Move::make<Move::NORMAL>(index + DOWN + DOWN, index));
+    if (PUSHES) {
+        addShifted(moves, single_push, DOWN);
+        addShifted(moves, double_push, DOWN, DOWN);
     }
 
     const Square ep = board.enpassantSq();
-    if (mt != MoveGenType::QUIET && ep != NO_SQ) {
+    if (CAPTURES && ep != NO_SQ) {
         const Square epPawn = ep + DOWN;
 
         const Bitboard ep_mask = (1ull << epPawn) | (1ull << ep);
@@ -2815,7 +3737,7 @@ void generatePawnMoves(const Board &board, Movelist &moves, Bitboard pin_d, Bitb
 template <Color c, MoveGenType mt>
 [[nodiscard]] inline Bitboard generateCastleMoves(const Board &board, Square sq, Bitboard seen,
                                                   Bitboard pinHV) {
-    if constexpr (mt == MoveGenType::CAPTURE) return 0ull;
+    if constexpr (mt != MoveGenType::ALL && mt != MoveGenType::QUIET) return 0ull;
     const auto rights = board.castlingRights();
 
     Bitboard moves = 0ull;
@@ -2850,11 +3772,29 @@ template <Color c, MoveGenType mt>
     return moves;
 }
 
-template <typename T>
-inline void whileBitboardAdd(Movelist &movelist, Bitboard mask, T func) {
+/// @brief [Internal Usage] The line through two squares on the same rank, file or
+/// diagonal, including both squares. Empty if they are not aligned.
+/// @param sq1
+/// @param sq2
+/// @return
+[[nodiscard]] inline Bitboard squaresAligned(Square sq1, Square sq2) {
+    const Bitboard ends = (1ULL << sq1) | (1ULL << sq2);
+    if (attacks::bishop(sq1, 0) & (1ULL << sq2))
+        return (attacks::bishop(sq1, 0) & attacks::bishop(sq2, 0)) | ends;
+    if (attacks::rook(sq1, 0) & (1ULL << sq2))
+        return (attacks::rook(sq1, 0) & attacks::rook(sq2, 0)) | ends;
+    return 0ull;
+}
+
+template <typename List, typename T>
+inline void whileBitboardAdd(List &movelist, Bitboard mask, T func) {
     while (mask) {
         const Square from = builtin::poplsb(mask);
         auto moves        = func(from);
+        if constexpr (std::is_same_v<List, MoveCounter>) {
+            movelist.count += builtin::popcount(moves);
+            continue;
+        }
         while (moves) {
             const Square to = builtin::poplsb(moves);
             movelist.add(Move::make<Move::NORMAL>(from, to));
@@ -2867,8 +3807,10 @@ inline void whileBitboardAdd(Movelist &movelist, Bitboard mask, T func) {
 /// @tparam mt
 /// @param movelist
 /// @param board
-template <Color c, MoveGenType mt>
-void legalmoves(Movelist &movelist, const Board &board, int pieces) {
+/// @param pieces
+/// @param info the checkers, check mask, pins and king danger squares of the position
+template <Color c, MoveGenType mt, typename List>
+void legalmoves(List &movelist, const Board &board, int pieces, const AttackInfo &info) {
     /*
      The size of the movelist might not
      be 0! This is done on purpose since it enables
@@ -2876,35 +3818,45 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
     */
     auto king_sq = board.kingSq(c);
 
-    int _doubleCheck = 0;
-
     Bitboard _occ_us        = board.us(c);
     Bitboard _occ_enemy     = board.us(~c);
     Bitboard _occ_all       = _occ_us | _occ_enemy;
     Bitboard _enemy_emptyBB = ~_occ_us;
 
-    Bitboard _checkMask = checkMask<c>(board, king_sq, _doubleCheck);
-    Bitboard _pinHV     = pinMaskRooks<c>(board, king_sq, _occ_enemy, _occ_us);
-    Bitboard _pinD      = pinMaskBishops<c>(board, king_sq, _occ_enemy, _occ_us);
+    Bitboard _checkMask = info.check_mask;
+
+    if (mt == MoveGenType::EVASION && !info.checkers) return;
 
-    assert(_doubleCheck <= 2);
+    Bitboard _pinHV = info.pin_hv;
+    Bitboard _pinD  = info.pin_d;
 
     // Moves have to be on the checkmask
     Bitboard movable_square;
 
     // Slider, Knights and King moves can only go to enemy or empty squares.
-    if (mt == MoveGenType::ALL)
+    if (mt == MoveGenType::ALL || mt == MoveGenType::EVASION)
         movable_square = _enemy_emptyBB;
-    else if (mt == MoveGenType::CAPTURE)
+    else if (mt == MoveGenType::CAPTURE || mt == MoveGenType::NOISY)
         movable_square = _occ_enemy;
-    else  // QUIET moves
+    else  // QUIET and QUIET_CHECK moves
         movable_square = ~_occ_all;
 
+    // Target squares of a piece that give check: QUIET_CHECK keeps the squares attacking the
+    // enemy king and, for a piece uncovering a slider, every square off that line
+    const CheckInfo &check_info = info.check_info;
+
+    auto checking = [&](Square sq, PieceType pt) -> Bitboard {
+        if constexpr (mt != MoveGenType::QUIET_CHECK) return constants::DEFAULT_CHECKMASK;
+        if (check_info.discoverers & (1ULL << sq)) return ~squaresAligned(check_info.king_sq, sq);
+        return check_info.check_squares[static_cast<int>(pt)];
+    };
+
     if (pieces & PieceGenType::KING) {
-        Bitboard _seen = seenSquares<~c>(board, _enemy_emptyBB);
+        Bitboard _seen = info.king_danger;
 
-        whileBitboardAdd(movelist, 1ull << king_sq,
-                         [&](Square sq) { return generateKingMoves(sq, _seen, movable_square); });
+        whileBitboardAdd(movelist, 1ull << king_sq, [&](Square sq) {
+            return generateKingMoves(sq, _seen, movable_square) & checking(sq, PieceType::KING);
+        });
 
         if (utils::squareRank(king_sq) == (c == Color::WHITE ? Rank::RANK_1 : Rank::RANK_8) &&
             (board.castlingRights().hasCastlingRight(c) &&
@@ -2921,7 +3873,7 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
     movable_square &= _checkMask;
 
     // Early return for double check as described earlier
-    if (_doubleCheck == 2) return;
+    if (info.checkers & (info.checkers - 1)) return;
 
     // Add the moves to the movelist.
     if (pieces & PieceGenType::PAWN) {
@@ -2932,8 +3884,9 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
         // Prune knights that are pinned since these cannot move.
         Bitboard knights_mask = board.pieces(PieceType::KNIGHT, c) & ~(_pinD | _pinHV);
 
-        whileBitboardAdd(movelist, knights_mask,
-                         [&](Square sq) { return generateKnightMoves(sq) & movable_square; });
+        whileBitboardAdd(movelist, knights_mask, [&](Square sq) {
+            return generateKnightMoves(sq) & movable_square & checking(sq, PieceType::KNIGHT);
+        });
     }
 
     if (pieces & PieceGenType::BISHOP) {
@@ -2941,7 +3894,8 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
         Bitboard bishops_mask = board.pieces(PieceType::BISHOP, c) & ~_pinHV;
 
         whileBitboardAdd(movelist, bishops_mask, [&](Square sq) {
-            return generateBishopMoves(sq, _pinD, _occ_all) & movable_square;
+            return generateBishopMoves(sq, _pinD, _occ_all) & movable_square &
+                   checking(sq, PieceType::BISHOP);
         });
     }
 
@@ -2950,7 +3904,8 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
         Bitboard rooks_mask = board.pieces(PieceType::ROOK, c) & ~_pinD;
 
         whileBitboardAdd(movelist, rooks_mask, [&](Square sq) {
-            return generateRookMoves(sq, _pinHV, _occ_all) & movable_square;
+            return generateRookMoves(sq, _pinHV, _occ_all) & movable_square &
+                   checking(sq, PieceType::ROOK);
         });
     }
 
@@ -2959,11 +3914,29 @@ void legalmoves(Movelist &movelist, const Board &board, int pieces) {
         Bitboard queens_mask = board.pieces(PieceType::QUEEN, c) & ~(_pinD & _pinHV);
 
         whileBitboardAdd(movelist, queens_mask, [&](Square sq) {
-            return generateQueenMoves(sq, _pinD, _pinHV, _occ_all) & movable_square;
+            return generateQueenMoves(sq, _pinD, _pinHV, _occ_all) & movable_square &
+                   checking(sq, PieceType::QUEEN);
         });
     }
 }
 
+/// @brief [Internal Usage] all legal moves for a position, computing only the part of the
+/// AttackInfo move generation reads
+/// @tparam c
+/// @tparam mt
+/// @param movelist
+/// @param board
+/// @param pieces
+template <Color c, MoveGenType mt, typename List>
+void legalmoves(List &movelist, const Board &board, int pieces) {
+    AttackInfo info;
+    kingSafety<c>(board, info);
+    info.king_danger = seenSquares<~c>(board, ~board.us(c));
+    if constexpr (mt == MoveGenType::QUIET_CHECK) info.check_info = board.checkInfo();
+
+    legalmoves<c, mt>(movelist, board, pieces, info);
+}
+
 template <MoveGenType mt>
 inline void legalmoves(Movelist &movelist, const Board &board, int pieces) {
     movelist.clear();
@@ -2974,8 +3947,728 @@ inline void legalmoves(Movelist &movelist, const Board &board, int pieces) {
         legalmoves<Color::BLACK, mt>(movelist, board, pieces);
 }
 
+template <MoveGenType mt>
+inline void legalmoves(Movelist &movelist, const Board &board, const AttackInfo &info,
+                       int pieces) {
+    movelist.clear();
+
+    if (board.sideToMove() == Color::WHITE)
+        legalmoves<Color::WHITE, mt>(movelist, board, pieces, info);
+    else
+        legalmoves<Color::BLACK, mt>(movelist, board, pieces, info);
+}
+
+template <MoveGenType mt>
+inline int countLegal(const Board &board) {
+    constexpr int ALL_PIECES = PieceGenType::PAWN | PieceGenType::KNIGHT | PieceGenType::BISHOP |
+                               PieceGenType::ROOK | PieceGenType::QUEEN | PieceGenType::KING;
+    MoveCounter counter;
+
+    if (board.sideToMove() == Color::WHITE)
+        legalmoves<Color::WHITE, mt>(counter, board, ALL_PIECES);
+    else
+        legalmoves<Color::BLACK, mt>(counter, board, ALL_PIECES);
+
+    return counter.count;
+}
+
+/// @brief [Internal Usage] Checks if the side to move has a legal move.
+/// @tparam c
+/// @param board
+/// @return
+template <Color c>
+[[nodiscard]] bool hasAnyLegalMove(const Board &board) {
+    const auto king_sq = board.kingSq(c);
+    const auto occ_us  = board.us(c);
+    const auto occ_all = board.occ();
+
+    int double_check      = 0;
+    const auto check_mask = checkMask<c>(board, king_sq, double_check);
+    const auto seen       = seenSquares<~c>(board, ~occ_us);
+
+    if (generateKingMoves(king_sq, seen, ~occ_us)) return true;
+    if (double_check == 2) return false;
+
+    const auto pin_hv  = pinMaskRooks<c>(board, king_sq, board.us(~c), occ_us);
+    const auto pin_d   = pinMaskBishops<c>(board, king_sq, board.us(~c), occ_us);
+    const auto movable = ~occ_us & check_mask;
+
+    MoveCounter pawn_moves;
+    generatePawnMoves<c, MoveGenType::ALL>(board, pawn_moves, pin_d, pin_hv, check_mask,
+                                           board.us(~c));
+    if (pawn_moves.count) return true;
+
+    auto any = [movable](Bitboard pieces, auto targets) {
+        while (pieces) {
+            if (targets(builtin::poplsb(pieces)) & movable) return true;
+        }
+        return false;
+    };
+
+    if (any(board.pieces(PieceType::KNIGHT, c) & ~(pin_d | pin_hv), generateKnightMoves) ||
+        any(board.pieces(PieceType::BISHOP, c) & ~pin_hv,
+            [&](Square sq) { return generateBishopMoves(sq, pin_d, occ_all); }) ||
+        any(board.pieces(PieceType::ROOK, c) & ~pin_d,
+            [&](Square sq) { return generateRookMoves(sq, pin_hv, occ_all); }) ||
+        any(board.pieces(PieceType::QUEEN, c) & ~(pin_d & pin_hv),
+            [&](Square sq) { return generateQueenMoves(sq, pin_d, pin_hv, occ_all); }))
+        return true;
+
+    // Only in Chess960 can castling be the last legal move, when the king cannot step
+    return check_mask == constants::DEFAULT_CHECKMASK && board.castlingRights().hasCastlingRight(c) &&
+           generateCastleMoves<c, MoveGenType::ALL>(board, king_sq, seen, pin_hv);
+}
+
+inline bool hasAnyLegalMove(const Board &board) {
+    return board.sideToMove() == Color::WHITE ? hasAnyLegalMove<Color::WHITE>(board)
+                                              : hasAnyLegalMove<Color::BLACK>(board);
+}
+
+/****************************************************************************\
+ * Batched legal move targets                                                *
+\****************************************************************************/
+
+/// @brief Bitboards of several positions processed side by side, one per lane, with GCC
+/// and Clang vector extensions. Falls back to a single scalar lane without AVX2.
+#if defined(__GNUC__) && defined(__AVX512F__)
+typedef Bitboard BatchLanes __attribute__((vector_size(64)));
+#elif defined(__GNUC__) && defined(__AVX2__)
+typedef Bitboard BatchLanes __attribute__((vector_size(32)));
+#else
+typedef Bitboard BatchLanes;
+#endif
+
+constexpr int BATCH_LANES = sizeof(BatchLanes) / sizeof(Bitboard);
+
+/// @brief [Internal Usage] All bits set in the lanes that are not zero.
+template <typename B>
+[[nodiscard]] inline B laneMask(B b) {
+    if constexpr (std::is_same_v<B, Bitboard>)
+        return b ? ~0ULL : 0ULL;
+    else
+        return (B)(b != 0);
+}
+
+/// @brief [Internal Usage] Population count of every lane, with shifts and adds only so it
+/// stays in vector registers.
+template <typename B>
+[[nodiscard]] inline B lanePopcount(B b) {
+    b = b - ((b >> 1) & 0x5555555555555555ULL);
+    b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+    b = (b + (b >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    b += b >> 8;
+    b += b >> 16;
+    b += b >> 32;
+    return b & 0x7F;
+}
+
+/// @brief [Internal Usage] Knight attacks of all knights at once, each direction apart so
+/// that knights sharing a target square are counted separately.
+template <typename B, typename F>
+inline void forEachKnightJump(B knights, F func) {
+    constexpr Bitboard NOT_A  = ~attacks::MASK_FILE[0];
+    constexpr Bitboard NOT_AB = ~(attacks::MASK_FILE[0] | attacks::MASK_FILE[1]);
+    constexpr Bitboard NOT_H  = ~attacks::MASK_FILE[7];
+    constexpr Bitboard NOT_GH = ~(attacks::MASK_FILE[6] | attacks::MASK_FILE[7]);
+
+    func((knights << 17) & NOT_A);
+    func((knights << 15) & NOT_H);
+    func((knights << 10) & NOT_AB);
+    func((knights << 6) & NOT_GH);
+    func((knights >> 6) & NOT_AB);
+    func((knights >> 10) & NOT_GH);
+    func((knights >> 15) & NOT_A);
+    func((knights >> 17) & NOT_H);
+}
+
+/// @brief [Internal Usage] Looks from the king in one direction for a checking slider, or
+/// a pinned own piece with a slider behind it.
+template <Direction d, typename B>
+inline void kingRay(B king, B occ, B us, B sliders, B &checkers, B &check_rays, B &pins) {
+    const B ray     = attacks::slide<d>(king, occ);
+    const B blocker = ray & us;
+    const B checker = ray & sliders;
+    const B xray    = attacks::slide<d>(king, occ ^ blocker);
+
+    checkers |= checker;
+    check_rays |= ray & laneMask(checker);
+    pins |= xray & laneMask(blocker) & laneMask(xray & ~ray & sliders);
+}
+
+template <typename B>
+void legalTargetLanes(const Position *positions, LegalTargets *targets) {
+    constexpr int N           = sizeof(B) / sizeof(Bitboard);
+    constexpr Bitboard RANK_1 = attacks::MASK_RANK[static_cast<int>(Rank::RANK_1)];
+    constexpr Bitboard RANK_3 = attacks::MASK_RANK[static_cast<int>(Rank::RANK_3)];
+    constexpr Bitboard RANK_8 = attacks::MASK_RANK[static_cast<int>(Rank::RANK_8)];
+
+    // Mirror the positions with black to move, so that every lane moves up the board
+    Bitboard lanes[6][N];
+    for (int i = 0; i < N; i++) {
+        const Position &pos = positions[i];
+        const bool black    = pos.side_to_move_;
+        auto orient         = [black](Bitboard b) { return black ? builtin::flipVertical(b) : b; };
+
+        lanes[0][i] = orient(pos.colors_[black]);
+        lanes[1][i] = orient(pos.colors_[!black]);
+        lanes[2][i] = orient(pos.pawns_);
+        lanes[3][i] = orient(pos.knights_);
+        lanes[4][i] = orient(pos.diagonal_);
+        lanes[5][i] = orient(pos.orthogonal_);
+    }
+
+    B us, them, pawns, knights, diagonal, orthogonal;
+    std::memcpy(&us, lanes[0], sizeof(B));
+    std::memcpy(&them, lanes[1], sizeof(B));
+    std::memcpy(&pawns, lanes[2], sizeof(B));
+    std::memcpy(&knights, lanes[3], sizeof(B));
+    std::memcpy(&diagonal, lanes[4], sizeof(B));
+    std::memcpy(&orthogonal, lanes[5], sizeof(B));
+
+    const B occ        = us | them;
+    const B empty      = ~occ;
+    const B kings      = occ & ~(pawns | knights | diagonal | orthogonal);
+    const B king       = kings & us;
+    const B their_diag = diagonal & them;
+    const B their_orth = orthogonal & them;
+
+    // Squares attacked by the enemy, sliders see through our king so that it cannot step
+    // back along their line
+    const B without_king = occ & ~king;
+    const B seen = attacks::shift<Direction::SOUTH_WEST>(pawns & them) |
+                   attacks::shift<Direction::SOUTH_EAST>(pawns & them) |
+                   attacks::knightSet(knights & them) | attacks::kingSet(kings & them) |
+                   attacks::bishopSet(their_diag, without_king) |
+                   attacks::rookSet(their_orth, without_king);
+
+    // Checkers, the lines they check along and the pin lines, like checkMask and
+    // pinMaskRooks/pinMaskBishops
+    B checkers = (attacks::shift<Direction::NORTH_WEST>(king) |
+                  attacks::shift<Direction::NORTH_EAST>(king)) &
+                 pawns & them;
+    checkers |= attacks::knightSet(king) & knights & them;
+
+    B check_rays = checkers;
+    B pin_d      = B{};
+    B pin_hv     = B{};
+    kingRay<Direction::NORTH_EAST>(king, occ, us, their_diag, checkers, check_rays, pin_d);
+    kingRay<Direction::NORTH_WEST>(king, occ, us, their_diag, checkers, check_rays, pin_d);
+    kingRay<Direction::SOUTH_EAST>(king, occ, us, their_diag, checkers, check_rays, pin_d);
+    kingRay<Direction::SOUTH_WEST>(king, occ, us, their_diag, checkers, check_rays, pin_d);
+    kingRay<Direction::NORTH>(king, occ, us, their_orth, checkers, check_rays, pin_hv);
+    kingRay<Direction::SOUTH>(king, occ, us, their_orth, checkers, check_rays, pin_hv);
+    kingRay<Direction::EAST>(king, occ, us, their_orth, checkers, check_rays, pin_hv);
+    kingRay<Direction::WEST>(king, occ, us, their_orth, checkers, check_rays, pin_hv);
+
+    // Everything when not in check, the checking line in single check, nothing in double
+    const B in_check     = laneMask(checkers);
+    const B double_check = laneMask(checkers & (checkers - 1));
+    const B checkmask    = ~in_check | (check_rays & ~double_check);
+    const B movable      = ~us & checkmask;
+    const B pinned       = pin_d | pin_hv;
+
+    // Pawns
+    const B our_pawns = pawns & us;
+    const B pawns_lr  = our_pawns & ~pin_hv;
+    const B pawns_hv  = our_pawns & ~pin_d;
+
+    const B left = (attacks::shift<Direction::NORTH_WEST>(pawns_lr & ~pin_d) |
+                    (attacks::shift<Direction::NORTH_WEST>(pawns_lr & pin_d) & pin_d)) &
+                   them & checkmask;
+    const B right = (attacks::shift<Direction::NORTH_EAST>(pawns_lr & ~pin_d) |
+                     (attacks::shift<Direction::NORTH_EAST>(pawns_lr & pin_d) & pin_d)) &
+                    them & checkmask;
+    const B push = (attacks::shift<Direction::NORTH>(pawns_hv & ~pin_hv) |
+                    (attacks::shift<Direction::NORTH>(pawns_hv & pin_hv) & pin_hv)) &
+                   empty;
+    const B single_push = push & checkmask;
+    const B double_push = attacks::shift<Direction::NORTH>(push & RANK_3) & empty & checkmask;
+
+    const B pawn_targets = left | right | single_push | double_push;
+    B counts = lanePopcount(left) + lanePopcount(right) + lanePopcount(single_push) +
+               lanePopcount(double_push) +
+               3 * (lanePopcount(left & RANK_8) + lanePopcount(right & RANK_8) +
+                    lanePopcount(single_push & RANK_8));
+
+    // Knights, pinned ones cannot move
+    B knight_targets = B{};
+    forEachKnightJump(knights & us & ~pinned, [&](B jumps) {
+        knight_targets |= jumps & movable;
+        counts += lanePopcount(jumps & movable);
+    });
+
+    // Sliders, pinned ones only along their pin line. Two sliders never reach the same
+    // square from the same direction, so every direction is counted on its own.
+    const B diag_free    = diagonal & us & ~pinned;
+    const B diag_pin     = diagonal & us & pin_d;
+    const B orth_free    = orthogonal & us & ~pinned;
+    const B orth_pin     = orthogonal & us & pin_hv;
+    B diagonal_targets   = B{};
+    B orthogonal_targets = B{};
+
+    auto addSlides = [&](B &slider_targets, auto directions, B free, B pinned_sliders, B pin) {
+        directions([&](auto dir) {
+            constexpr Direction d = decltype(dir)::value;
+            const B moves =
+                (attacks::slide<d>(free, occ) | (attacks::slide<d>(pinned_sliders, occ) & pin)) &
+                movable;
+            slider_targets |= moves;
+            counts += lanePopcount(moves);
+        });
+    };
+    auto diagonals = [](auto func) {
+        func(std::integral_constant<Direction, Direction::NORTH_EAST>{});
+        func(std::integral_constant<Direction, Direction::NORTH_WEST>{});
+        func(std::integral_constant<Direction, Direction::SOUTH_EAST>{});
+        func(std::integral_constant<Direction, Direction::SOUTH_WEST>{});
+    };
+    auto orthogonals = [](auto func) {
+        func(std::integral_constant<Direction, Direction::NORTH>{});
+        func(std::integral_constant<Direction, Direction::SOUTH>{});
+        func(std::integral_constant<Direction, Direction::EAST>{});
+        func(std::integral_constant<Direction, Direction::WEST>{});
+    };
+    addSlides(diagonal_targets, diagonals, diag_free, diag_pin, pin_d);
+    addSlides(orthogonal_targets, orthogonals, orth_free, orth_pin, pin_hv);
+
+    const B king_targets = attacks::kingSet(king) & ~us & ~seen;
+    counts += lanePopcount(king_targets);
+
+    Bitboard out[9][N];
+    std::memcpy(out[0], &pawn_targets, sizeof(B));
+    std::memcpy(out[1], &knight_targets, sizeof(B));
+    std::memcpy(out[2], &diagonal_targets, sizeof(B));
+    std::memcpy(out[3], &orthogonal_targets, sizeof(B));
+    std::memcpy(out[4], &king_targets, sizeof(B));
+    std::memcpy(out[5], &counts, sizeof(B));
+    std::memcpy(out[6], &seen, sizeof(B));
+    std::memcpy(out[7], &checkers, sizeof(B));
+    std::memcpy(out[8], &pin_hv, sizeof(B));
+
+    for (int i = 0; i < N; i++) {
+        const Position &pos  = positions[i];
+        const bool black     = pos.side_to_move_;
+        LegalTargets &result = targets[i];
+
+        result.pawns      = out[0][i];
+        result.knights    = out[1][i];
+        result.diagonal   = out[2][i];
+        result.orthogonal = out[3][i];
+        result.king       = out[4][i];
+        result.count      = static_cast<int>(out[5][i]);
+
+        // En passant and castling are rare, they are checked one lane at a time
+        const Bitboard lane_us   = lanes[0][i];
+        const Bitboard lane_them = lanes[1][i];
+        const Bitboard lane_occ  = lane_us | lane_them;
+        const Square king_sq     = Square(pos.kings_[black] ^ (black ? 56 : 0));
+
+        if (pos.enpassant_ != NO_SQ) {
+            const Square ep       = Square(pos.enpassant_ ^ (black ? 56 : 0));
+            const Square captured = Square(ep - 8);
+            Bitboard from_bb      = attacks::pawn(Color::BLACK, ep) & lanes[2][i] & lane_us;
+            while (from_bb) {
+                const Square from   = builtin::poplsb(from_bb);
+                const Bitboard occ  = (lane_occ ^ (1ULL << from) ^ (1ULL << captured)) | (1ULL << ep);
+                const Bitboard them = lane_them & ~(1ULL << captured);
+                const bool attacked =
+                    (attacks::knight(king_sq) & lanes[3][i] & them) ||
+                    (attacks::pawn(Color::WHITE, king_sq) & lanes[2][i] & them) ||
+                    (attacks::bishop(king_sq, occ) & lanes[4][i] & them) ||
+                    (attacks::rook(king_sq, occ) & lanes[5][i] & them);
+                if (!attacked) {
+                    result.pawns |= 1ULL << ep;
+                    result.count++;
+                }
+            }
+        }
+
+        const Color color = Color(black);
+        if (pos.castling_ && !out[7][i]) {
+            for (const auto side : {CastleSide::KING_SIDE, CastleSide::QUEEN_SIDE}) {
+                const File rook_file = pos.rookFile(color, side);
+                if (rook_file == File::NO_FILE) continue;
+
+                const bool king_side  = side == CastleSide::KING_SIDE;
+                const Square rook_sq  = utils::fileRankSquare(rook_file, Rank::RANK_1);
+                const Square king_to  = king_side ? Square::SQ_G1 : Square::SQ_C1;
+                const Square rook_to  = king_side ? Square::SQ_F1 : Square::SQ_D1;
+                const Bitboard rook   = 1ULL << rook_sq;
+                const Bitboard others = lane_occ & ~rook & ~(1ULL << king_sq);
+
+                if (!(SQUARES_BETWEEN_BB[king_sq][rook_sq] & lane_occ) &&
+                    !(SQUARES_BETWEEN_BB[king_sq][king_to] & (out[6][i] | others)) &&
+                    !(rook & out[8][i] & RANK_1) && !((1ULL << rook_to) & others) &&
+                    !((1ULL << king_to) & (out[6][i] | others))) {
+                    result.king |= rook;
+                    result.count++;
+                }
+            }
+        }
+
+        if (black) {
+            result.pawns      = builtin::flipVertical(result.pawns);
+            result.knights    = builtin::flipVertical(result.knights);
+            result.diagonal   = builtin::flipVertical(result.diagonal);
+            result.orthogonal = builtin::flipVertical(result.orthogonal);
+            result.king       = builtin::flipVertical(result.king);
+        }
+    }
+}
+
+inline void legalTargets(const Position *positions, LegalTargets *targets, size_t count) {
+    size_t i = 0;
+    for (; i + BATCH_LANES <= count; i += BATCH_LANES) {
+        legalTargetLanes<BatchLanes>(positions + i, targets + i);
+    }
+    for (; i < count; i++) {
+        legalTargetLanes<Bitboard>(positions + i, targets + i);
+    }
+}
+
+/// @brief [Internal Usage] Checks if a pseudo legal move keeps the king out of check.
+/// @tparam c
+/// @param board
+/// @param move
+/// @return
+template <Color c>
+[[nodiscard]] bool isLegal(const Board &board, const Move &move) {
+    const auto king_sq = board.kingSq(c);
+    const auto from    = move.from();
+    const auto to      = move.to();
+
+    // Castling moves are fully validated by isPseudoLegal
+    if (move.typeOf() == Move::CASTLING) return true;
+
+    if (from == king_sq) {
+        return !attacks::attackers(board, ~c, to, board.occ() & ~(1ULL << from));
+    }
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        // Both pawns leave their squares, which can uncover a slider on the king
+        const auto captured = Square(int(to) ^ 8);
+        const auto occ      = (board.occ() & ~(1ULL << from) & ~(1ULL << captured)) | (1ULL << to);
+        return !attacks::attackers(board, ~c, king_sq, occ);
+    }
+
+    int double_check     = 0;
+    const auto checkmask = checkMask<c>(board, king_sq, double_check);
+    if (double_check == 2 || !(checkmask & (1ULL << to))) return false;
+
+    // A pinned piece may only move along the line through the king and itself
+    const auto pinned = pinMaskRooks<c>(board, king_sq, board.us(~c), board.us(c)) |
+                        pinMaskBishops<c>(board, king_sq, board.us(~c), board.us(c));
+    return !(pinned & (1ULL << from)) || (SQUARES_BETWEEN_BB[king_sq][from] & (1ULL << to)) ||
+           (SQUARES_BETWEEN_BB[king_sq][to] & (1ULL << from));
+}
+
+/// @brief [Internal Usage] Checks if a move could be generated, ignoring checks and pins.
+/// @tparam c
+/// @param board
+/// @param move
+/// @return
+template <Color c>
+[[nodiscard]] bool isPseudoLegal(const Board &board, const Move &move) {
+    const auto from  = move.from();
+    const auto to    = move.to();
+    const auto piece = board.at(from);
+
+    if (from == to || piece == Piece::NONE || Board::color(piece) != c) return false;
+
+    // Only promotions carry a promotion piece
+    if (move.typeOf() != Move::PROMOTION && (move.move() >> 12) & 3) return false;
+
+    if (move.typeOf() == Move::CASTLING) {
+        if (utils::typeOfPiece(piece) != PieceType::KING) return false;
+
+        Movelist moves;
+        legalmoves<c, MoveGenType::ALL>(moves, board, PieceGenType::KING);
+        return moves.find(move) != -1;
+    }
+
+    if (board.us(c) & (1ULL << to)) return false;
+
+    const auto pt = utils::typeOfPiece(piece);
+    if (pt != PieceType::PAWN) {
+        if (move.typeOf() != Move::NORMAL) return false;
+
+        switch (pt) {
+            case PieceType::KNIGHT:
+                return attacks::knight(from) & (1ULL << to);
+            case PieceType::BISHOP:
+                return attacks::bishop(from, board.occ()) & (1ULL << to);
+            case PieceType::ROOK:
+                return attacks::rook(from, board.occ()) & (1ULL << to);
+            case PieceType::QUEEN:
+                return attacks::queen(from, board.occ()) & (1ULL << to);
+            default:
+                return attacks::king(from) & (1ULL << to);
+        }
+    }
+
+    constexpr Direction UP = c == Color::WHITE ? Direction::NORTH : Direction::SOUTH;
+    constexpr Rank DOUBLE_PUSH_RANK = c == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7;
+    constexpr Rank PROMOTION_RANK   = c == Color::WHITE ? Rank::RANK_8 : Rank::RANK_1;
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        return to == board.enpassantSq() && (attacks::pawn(c, from) & (1ULL << to));
+    }
+
+    if ((utils::squareRank(to) == PROMOTION_RANK) != (move.typeOf() == Move::PROMOTION)) {
+        return false;
+    }
+
+    if (attacks::pawn(c, from) & board.us(~c) & (1ULL << to)) return true;
+
+    if (board.occ() & (1ULL << to)) return false;
+
+    return to == from + UP || (utils::squareRank(from) == DOUBLE_PUSH_RANK &&
+                               to == from + UP + UP && board.at(from + UP) == Piece::NONE);
+}
+
 }  // namespace movegen
 
+inline bool Board::isPseudoLegal(const Move &move) const {
+    return side_to_move_ == Color::WHITE ? movegen::isPseudoLegal<Color::WHITE>(*this, move)
+                                         : movegen::isPseudoLegal<Color::BLACK>(*this, move);
+}
+
+inline bool Board::isLegal(const Move &move) const {
+    return side_to_move_ == Color::WHITE ? movegen::isLegal<Color::WHITE>(*this, move)
+                                         : movegen::isLegal<Color::BLACK>(*this, move);
+}
+
+inline int Board::see(const Move &move) const {
+    if (move.typeOf() == Move::CASTLING) return 0;
+
+    const auto to     = move.to();
+    Bitboard occupied = occ() ^ (1ULL << move.from());
+    Color side        = ~side_to_move_;
+
+    // gain[d] is the balance for the side making the d-th capture if the sequence stopped
+    // right after it
+    int gain[32];
+    int depth = 0;
+    int next  = SEE_VALUES[static_cast<int>(at<PieceType>(move.from()))];
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        occupied ^= 1ULL << (int(to) ^ 8);
+        gain[0] = SEE_VALUES[static_cast<int>(PieceType::PAWN)];
+    } else {
+        gain[0] = SEE_VALUES[static_cast<int>(at<PieceType>(to))];
+    }
+
+    if (move.typeOf() == Move::PROMOTION) {
+        next = SEE_VALUES[static_cast<int>(move.promotionType())];
+        gain[0] += next - SEE_VALUES[static_cast<int>(PieceType::PAWN)];
+    }
+
+    const Bitboard bishops = pieces(PieceType::BISHOP) | pieces(PieceType::QUEEN);
+    const Bitboard rooks   = pieces(PieceType::ROOK) | pieces(PieceType::QUEEN);
+    Bitboard attackers     = attacks::attackers(*this, Color::WHITE, to, occupied) |
+                         attacks::attackers(*this, Color::BLACK, to, occupied);
+
+    while (depth < 31) {
+        attackers &= occupied;
+        const Bitboard ours = attackers & us(side);
+        if (!ours) break;
+
+        // Least valuable attacker
+        auto pt = PieceType::PAWN;
+        while (!(ours & pieces(pt, side))) pt = PieceType(static_cast<int>(pt) + 1);
+
+        depth++;
+        gain[depth] = next - gain[depth - 1];
+        next        = SEE_VALUES[static_cast<int>(pt)];
+
+        occupied ^= 1ULL << builtin::lsb(ours & pieces(pt, side));
+
+        // Sliders behind the piece that just captured join in
+        if (pt == PieceType::PAWN || pt == PieceType::BISHOP || pt == PieceType::QUEEN)
+            attackers |= attacks::bishop(to, occupied) & bishops;
+        if (pt == PieceType::ROOK || pt == PieceType::QUEEN)
+            attackers |= attacks::rook(to, occupied) & rooks;
+
+        side = ~side;
+    }
+
+    while (depth > 0) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        depth--;
+    }
+
+    return gain[0];
+}
+
+inline bool Board::seeGe(const Move &move, int threshold) const {
+    // Rare enough that the full evaluation is not worth a specialized path
+    if (move.typeOf() != Move::NORMAL) return see(move) >= threshold;
+
+    const auto from = move.from();
+    const auto to   = move.to();
+
+    // swap is what the side to move still has to win for the exchange to pass
+    int swap = SEE_VALUES[static_cast<int>(at<PieceType>(to))] - threshold;
+    if (swap < 0) return false;
+
+    swap = SEE_VALUES[static_cast<int>(at<PieceType>(from))] - swap;
+    if (swap <= 0) return true;
+
+    Bitboard occupied = occ() ^ (1ULL << from) ^ (1ULL << to);
+    Color side        = side_to_move_;
+
+    const Bitboard bishops = pieces(PieceType::BISHOP) | pieces(PieceType::QUEEN);
+    const Bitboard rooks   = pieces(PieceType::ROOK) | pieces(PieceType::QUEEN);
+    Bitboard attackers     = attacks::attackers(*this, Color::WHITE, to, occupied) |
+                         attacks::attackers(*this, Color::BLACK, to, occupied);
+
+    bool result = true;
+
+    while (true) {
+        side = ~side;
+        attackers &= occupied;
+
+        const Bitboard ours = attackers & us(side);
+        if (!ours) break;
+
+        result = !result;
+
+        auto pt = PieceType::PAWN;
+        while (!(ours & pieces(pt, side))) pt = PieceType(static_cast<int>(pt) + 1);
+
+        // A king may only capture last
+        if (pt == PieceType::KING) return (attackers & us(~side)) ? !result : result;
+
+        swap = SEE_VALUES[static_cast<int>(pt)] - swap;
+        if (swap < static_cast<int>(result)) break;
+
+        occupied ^= 1ULL << builtin::lsb(ours & pieces(pt, side));
+
+        if (pt == PieceType::PAWN || pt == PieceType::BISHOP || pt == PieceType::QUEEN)
+            attackers |= attacks::bishop(to, occupied) & bishops;
+        if (pt == PieceType::ROOK || pt == PieceType::QUEEN)
+            attackers |= attacks::rook(to, occupied) & rooks;
+    }
+
+    return result;
+}
+
+inline CheckInfo Board::checkInfo() const {
+    CheckInfo info;
+    const auto color    = side_to_move_;
+    const auto ksq      = kingSq(~color);
+    const auto occupied = occ();
+    const auto bishop   = attacks::bishop(ksq, occupied);
+    const auto rook     = attacks::rook(ksq, occupied);
+
+    info.king_sq                                            = ksq;
+    info.check_squares[static_cast<int>(PieceType::PAWN)]   = attacks::pawn(~color, ksq);
+    info.check_squares[static_cast<int>(PieceType::KNIGHT)] = attacks::knight(ksq);
+    info.check_squares[static_cast<int>(PieceType::BISHOP)] = bishop;
+    info.check_squares[static_cast<int>(PieceType::ROOK)]   = rook;
+    info.check_squares[static_cast<int>(PieceType::QUEEN)]  = bishop | rook;
+    info.check_squares[static_cast<int>(PieceType::KING)]   = 0;
+
+    // Own sliders that would see the king on an empty board, with exactly one piece in
+    // between which is ours
+    const auto queens = pieces(PieceType::QUEEN, color);
+    Bitboard snipers  = (attacks::bishop(ksq, 0) & (pieces(PieceType::BISHOP, color) | queens)) |
+                       (attacks::rook(ksq, 0) & (pieces(PieceType::ROOK, color) | queens));
+
+    info.discoverers = 0;
+    while (snipers) {
+        const auto between = movegen::SQUARES_BETWEEN_BB[ksq][builtin::poplsb(snipers)] & occupied;
+        if (builtin::popcount(between) == 1) info.discoverers |= between & us(color);
+    }
+
+    return info;
+}
+
+inline bool Board::givesCheck(const Move &move, const CheckInfo &info) const {
+    const auto from  = move.from();
+    const auto to    = move.to();
+    const auto ksq   = info.king_sq;
+    const auto color = side_to_move_;
+
+    if (move.typeOf() != Move::CASTLING) {
+        if (info.check_squares[static_cast<int>(at<PieceType>(from))] & (1ULL << to)) return true;
+
+        // The moving piece uncovers a slider unless it stays on the line to the king
+        if ((info.discoverers & (1ULL << from)) &&
+            !(movegen::SQUARES_BETWEEN_BB[ksq][from] & (1ULL << to)) &&
+            !(movegen::SQUARES_BETWEEN_BB[ksq][to] & (1ULL << from)))
+            return true;
+    }
+
+    if (move.typeOf() == Move::NORMAL) return false;
+
+    const auto queens = pieces(PieceType::QUEEN, color);
+    auto bishops      = pieces(PieceType::BISHOP, color) | queens;
+    auto rooks        = pieces(PieceType::ROOK, color) | queens;
+    auto occupied     = occ() ^ (1ULL << from);
+
+    if (move.typeOf() == Move::PROMOTION) {
+        switch (move.promotionType()) {
+            case PieceType::KNIGHT:
+                return attacks::knight(to) & (1ULL << ksq);
+            case PieceType::BISHOP:
+                return attacks::bishop(to, occupied) & (1ULL << ksq);
+            case PieceType::ROOK:
+                return attacks::rook(to, occupied) & (1ULL << ksq);
+            default:
+                return attacks::queen(to, occupied) & (1ULL << ksq);
+        }
+    }
+
+    if (move.typeOf() == Move::ENPASSANT) {
+        // Removing the captured pawn can open a line the moving pawn did not
+        occupied ^= (1ULL << (int(to) ^ 8)) | (1ULL << to);
+    } else {
+        // Castling is encoded as king takes rook, both end up on fixed squares
+        const bool king_side = to > from;
+        const auto king_to = utils::relativeSquare(color, king_side ? Square::SQ_G1 : Square::SQ_C1);
+        const auto rook_to = utils::relativeSquare(color, king_side ? Square::SQ_F1 : Square::SQ_D1);
+        occupied = (occupied ^ (1ULL << to)) | (1ULL << king_to) | (1ULL << rook_to);
+        rooks    = (rooks ^ (1ULL << to)) | (1ULL << rook_to);
+    }
+
+    return (attacks::bishop(ksq, occupied) & bishops) | (attacks::rook(ksq, occupied) & rooks);
+}
+
+inline AttackInfo Board::attackInfo() const {
+    return side_to_move_ == Color::WHITE ? movegen::attackInfo<Color::WHITE>(*this)
+                                         : movegen::attackInfo<Color::BLACK>(*this);
+}
+
+/// @brief [Internal Usage] Checks if the enemy cannot recapture on the target square of a
+/// normal move, also not with a slider behind the moving piece.
+/// @param board
+/// @param move
+/// @param info
+/// @return
+[[nodiscard]] inline bool seeUncontested(const Board &board, const Move &move,
+                                         const AttackInfo &info) {
+    const auto them    = ~board.sideToMove();
+    const auto sliders = board.pieces(PieceType::BISHOP, them) |
+                         board.pieces(PieceType::ROOK, them) | board.pieces(PieceType::QUEEN, them);
+
+    return move.typeOf() == Move::NORMAL &&
+           !(info.attacked[static_cast<int>(them)] & (1ULL << move.to())) &&
+           !(movegen::squaresAligned(move.from(), move.to()) & sliders);
+}
+
+inline int Board::see(const Move &move, const AttackInfo &info) const {
+    if (seeUncontested(*this, move, info))
+        return SEE_VALUES[static_cast<int>(at<PieceType>(move.to()))];
+    return see(move);
+}
+
+inline bool Board::seeGe(const Move &move, int threshold, const AttackInfo &info) const {
+    if (seeUncontested(*this, move, info))
+        return SEE_VALUES[static_cast<int>(at<PieceType>(move.to()))] >= threshold;
+    return seeGe(move, threshold);
+}
+
 /****************************************************************************\
  * uci utility functions                                                     *
 \****************************************************************************/
@@ -3016,7 +4709,7 @@ namespace uci {
 /// @param board
 /// @param uci
 /// @return
-[[nodiscard]] inline Move uciToMove(const Board &board, const std::string &uci) {
+[[nodiscard]] inline Move uciToMove(const Board &board, std::string_view uci) {
     Square source   = utils::extractSquare(uci.substr(0, 2));
     Square target   = utils::extractSquare(uci.substr(2, 2));
     PieceType piece = utils::typeOfPiece(board.at(source));
@@ -0,0 +1,170 @@
+#include "epd.h"
+#include "numa.h"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+using namespace chess;
+
+struct EpdPosition {
+  std::string fen;
+  std::string id;
+  Movelist bestMoves;  // bm
+  Movelist avoidMoves; // am
+  std::string solution; // The bm/am operation as written in the file
+};
+
+struct EpdResult {
+  Move move = Move::NO_MOVE;
+  bool solved = false;
+  int64_t solveTime = 0; // Time and nodes until the engine settled on a
+  uint64_t solveNodes = 0; // solving move for good
+};
+
+// Parse a line like: <4 FEN fields> bm Qg6; id "WAC.001";
+static bool parseEpd(const std::string &line, EpdPosition &position) {
+  std::istringstream fields(line);
+  std::string field;
+  for (int i = 0; i < 4 && fields >> field; i++) {
+    position.fen += (i ? " " : "") + field;
+  }
+  if (position.fen.empty()) {
+    return false;
+  }
+  Board board(position.fen);
+
+  std::string operation;
+  while (std::getline(fields, operation, ';')) {
+    std::istringstream operands(operation);
+    std::string opcode;
+    if (!(operands >> opcode)) {
+      continue;
+    }
+    if (opcode == "id") {
+      std::getline(operands >> std::ws, position.id);
+      position.id.erase(0, position.id.find_first_not_of('"'));
+      position.id.erase(position.id.find_last_not_of('"') + 1);
+    } else if (opcode == "bm" || opcode == "am") {
+      Movelist &moves = opcode == "bm" ? position.bestMoves : position.avoidMoves;
+      position.solution = operation.substr(operation.find(opcode));
+      std::string san;
+      while (operands >> san) {
+        try {
+          moves.add(uci::parseSan(board, san));
+        } catch (const uci::SanParseError &) {
+          sendLine("info string cannot parse " + san + " in " + line);
+        }
+      }
+    }
+  }
+  return !position.bestMoves.empty() || !position.avoidMoves.empty();
+}
+
+static bool solves(const EpdPosition &position, Move move) {
+  return (position.bestMoves.empty() || position.bestMoves.find(move) != -1) &&
+         position.avoidMoves.find(move) == -1;
+}
+
+void runEpd(const std::string &path, const Limits &limits, int threads) {
+  std::ifstream file(path);
+  if (!file) {
+    sendLine("info string cannot open " + path);
+    return;
+  }
+  std::vector<EpdPosition> positions;
+  std::string line;
+  while (std::getline(file, line)) {
+    EpdPosition position;
+    if (parseEpd(line, position)) {
+      if (position.id.empty()) {
+        position.id = "#" + std::to_string(positions.size() + 1);
+      }
+      positions.push_back(std::move(position));
+    }
+  }
+
+  // Workers claim positions one at a time, each with its own search state
+  std::vector<EpdResult> results(positions.size());
+  std::atomic<size_t> next{0};
+  STAT(std::vector<SearchStats> workerStats(threads));
+  auto worker = [&](int index) {
+    bindThreadToNode(index); // Before the table is allocated and touched
+    TranspositionTable tt;
+    tt.resize(DEFAULT_HASH, 1);
+    Search searcher;
+    searcher.silent = true;
+    searcher.tt = &tt;
+    for (size_t i = next++; i < positions.size(); i = next++) {
+      EpdResult &result = results[i];
+      tt.clear(1); // Positions are solved independently of each other
+      searcher.stopped = false; // Set by the limits of the previous position
+      result.move = searcher.start(Board(positions[i].fen), limits);
+      STAT(workerStats[index] += searcher.stats);
+
+      // Find the iteration from which on every best move was a solution
+      const std::vector<Iteration> &iterations = searcher.iterations();
+      for (auto it = iterations.rbegin();
+           it != iterations.rend() && solves(positions[i], it->bestMove); ++it) {
+        result.solved = true;
+        result.solveTime = it->time;
+        result.solveNodes = it->nodes;
+      }
+    }
+  };
+  // Even the first worker gets its own thread, binding the caller to a node
+  // would restrict it and every thread it creates later
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+
+  int solved = 0;
+  for (size_t i = 0; i < positions.size(); i++) {
+    const EpdResult &result = results[i];
+    std::string report = positions[i].id + " " + positions[i].solution + " played " +
+                         (result.move == Move::NO_MOVE
+                              ? "0000"
+                              : uci::moveToSan(Board(positions[i].fen), result.move));
+    if (result.solved) {
+      solved++;
+      report += " solved in " + std::to_string(result.solveTime) + " ms " +
+                std::to_string(result.solveNodes) + " nodes";
+    }
+    sendLine(report);
+  }
+
+  // Solve counts when the suite would have been run with a fraction of the
+  // limit. Node limits are scaled when given, the move time otherwise.
+  sendLine("===========================");
+  for (int divisor : {8, 4, 2, 1}) {
+    if (!limits.nodes && !limits.movetime) {
+      break; // Depth limited, there is nothing to scale
+    }
+    int count = 0;
+    std::string threshold;
+    for (const EpdResult &result : results) {
+      if (limits.nodes) {
+        count += result.solved && result.solveNodes <= limits.nodes / divisor;
+        threshold = std::to_string(limits.nodes / divisor) + " nodes";
+      } else {
+        count += result.solved && result.solveTime <= limits.movetime / divisor;
+        threshold = std::to_string(limits.movetime / divisor) + " ms";
+      }
+    }
+    sendLine("Solved within " + threshold + " : " + std::to_string(count) + "/" +
+             std::to_string(positions.size()));
+  }
+  sendLine("Solved          : " + std::to_string(solved) + "/" +
+           std::to_string(positions.size()));
+
+#ifdef STATS
+  SearchStats total;
+  for (const SearchStats &stats : workerStats) {
+    total += stats;
+  }
+  sendLine(total.report(false));
+#endif
+}
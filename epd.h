@@ -0,0 +1,14 @@
+#ifndef EPD_H
+#define EPD_H
+
+#include "search.h"
+#include <string>
+
+// Search every position of an EPD test suite with the given limits, spread
+// over worker threads, and report which positions were solved according to
+// their bm (best move) or am (avoid move) opcodes. Besides the solve count at
+// the limit, the count within fractions of the limit is reported, based on
+// how long it took until the engine settled on a correct move.
+void runEpd(const std::string &path, const Limits &limits, int threads);
+
+#endif
@@ -1,167 +1,419 @@
+#include "bench.h"
 #include "chess.hpp"
-#include <future>
+#include "epd.h"
+#include "match.h"
+#include "numa.h"
+#include "perft.h"
+#include "search.h"
+#include "tt.h"
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
-#include <cmath>
 using namespace chess;
 
-float eval(Board board, Movelist moves);
-Move start_negamax(Board board, int depth);
-float negamax(Board board, int depth, float alpha, float beta);
+// Lines read from stdin, waiting to be handled by the dispatcher in main()
+std::deque<std::string> commands;
+std::mutex queueMutex;
+std::condition_variable queueSignal; // New command queued or search finished
+bool searchFinished = false;
+Move searchResult = Move::NO_MOVE;
 
-int main() {
-  constexpr
-  std::chrono::duration<int> zeroseconds = std::chrono::duration<int>::zero();
-  std::future<void> ioTask;     // This will handle the async IO task
-  std::future<Move> searchTask; // This will handle the async Search task
-  std::string stdin;
-  std::string command;
-  std::launch mode = std::launch::async;
+// Split off the first whitespace separated token of text
+std::string_view nextToken(std::string_view &text) {
+  const size_t begin = std::min(text.find_first_not_of(" \t"), text.size());
+  text.remove_prefix(begin);
+  const size_t end = std::min(text.find_first_of(" \t"), text.size());
+  const std::string_view token = text.substr(0, end);
+  text.remove_prefix(end);
+  return token;
+}
 
-  Board board;
-  bool running = true;
-  bool prompting = true;
-  bool searching = false;
-  while (running) {
-    if (prompting) { // True in the first iteration, thereafter only if the old
-                     // IO Task finished
-      ioTask = std::async(mode, [&]() { std::getline(std::cin, stdin); });
+// Parse the value of a spin option, fails unless all of it is an integer
+bool parseInteger(const std::string &text, int64_t &value) {
+  const char *end = text.data() + text.size();
+  const auto [last, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && last == end;
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+// GUIs resend the whole game with every move. base and moves remember the
+// last position command so that when the new one only extends its move list,
+// just the new moves are made instead of replaying the game.
+void setPosition(std::string_view args, Board &board, std::string &base,
+                 std::string &moves) {
+  std::string_view rest = args;
+  std::string_view token = nextToken(rest);
+  std::string_view fen;
+  if (token == "startpos") {
+    fen = constants::STARTPOS;
+    token = nextToken(rest);
+  } else if (token == "fen") {
+    rest.remove_prefix(std::min(rest.find_first_not_of(" \t"), rest.size()));
+    const std::string_view fields = rest;
+    size_t length = 0;
+    for (token = nextToken(rest); !token.empty() && token != "moves";
+         token = nextToken(rest)) {
+      length = token.data() + token.size() - fields.data();
     }
+    fen = fields.substr(0, length);
+  } else {
+    sendLine("info string invalid position command");
+    return;
+  }
 
-    // Prepare starting a new IO Task in the next iteration if the old IO Task
-    // finished
-    prompting = (ioTask.wait_for(zeroseconds) == std::future_status::ready);
+  const std::string_view moveList = token == "moves" ? rest : std::string_view();
 
-    // If the old IO Task finished, a command has been received that needs to be
-    // handled
-    if (prompting) {
-      std::istringstream commandline(stdin);
-      commandline >> command;
-      if (command == "uci") {
-        std::cout << "id name Leo" << std::endl;
-        std::cout << "uciok" << std::endl;
-      } else if (command == "isready") {
-        std::cout << "readyok" << std::endl;
-      } else if (command == "position") {
-        commandline >> command;
-        if (command == "startpos") {
-          board = Board(constants::STARTPOS);
-          commandline >> command;
-          if (command == "moves") {
-            while (commandline >> command) {
-              board.makeMove(uci::uciToMove(board, command));
-            }
-          }
-        } else {
-          std::cout << "Error: Custom Positions Not Supported" << std::endl;
-        }
-      } else if (command == "ucinewgame") {
-      } else if (command == "go") {
-        searchTask =
-          std::async(mode, [board]() mutable {return start_negamax(board, 5);});
-          // create a thread-local copy
-
-        searching = true;
-      } else if (command == "stop") {
-        searching = false;
-        std::cout << "bestmove " << uci::moveToUci(searchTask.get())<<std::endl;
-      } else if (command == "quit") {
-        running = false;
-      } else {
-        std::cout << "Error: invalid command" << std::endl;
-        running = false;
+  // Skip the moves the board already has, as long as they match
+  size_t known = 0; // Characters of the remembered moves already matched
+  rest = moveList;
+  token = nextToken(rest);
+  if (fen == base) {
+    for (; !token.empty() && known < moves.size(); token = nextToken(rest)) {
+      if (moves.compare(known, token.size(), token) != 0 ||
+          (known + token.size() < moves.size() &&
+           moves[known + token.size()] != ' ')) {
+        break;
       }
+      known = std::min(known + token.size() + 1, moves.size());
     }
-    if (searching && searchTask.valid() &&
-        searchTask.wait_for(zeroseconds) == std::future_status::ready) {
-      std::cout << "bestmove " << uci::moveToUci(searchTask.get())<<std::endl;
+  }
+  if (fen != base || known < moves.size()) {
+    // A new game, a different history or a takeback
+    board.setFen(fen);
+    base = fen;
+    moves.clear();
+    rest = moveList;
+    token = nextToken(rest);
+  }
+
+  for (; !token.empty(); token = nextToken(rest)) {
+    board.makeMove(uci::uciToMove(board, token));
+    if (!moves.empty()) {
+      moves += ' ';
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    moves += token;
   }
-  return 0;
 }
 
-float eval(Board board, Movelist legalmoves,  Movelist opponentmoves) {
-  constexpr auto WHITE = Color::WHITE; // alias
-  constexpr auto BLACK = Color::BLACK; // alias
-  Bitboard wPawns = board.pieces(PieceType::PAWN, WHITE);
-  Bitboard bPawns = board.pieces(PieceType::PAWN, BLACK);
-  uint wMaterial = 1 * builtin::popcount(wPawns)
-                 + 3 * builtin::popcount(board.pieces(PieceType::KNIGHT, WHITE)|
-                                         board.pieces(PieceType::BISHOP, WHITE))
-                 + 5 * builtin::popcount(board.pieces(PieceType::ROOK, WHITE))
-                 + 9 * builtin::popcount(board.pieces(PieceType::QUEEN, WHITE));
-  uint bMaterial = 1 * builtin::popcount(bPawns)
-                 + 3 * builtin::popcount(board.pieces(PieceType::KNIGHT, BLACK)|
-                                         board.pieces(PieceType::BISHOP, BLACK))
-                 + 5 * builtin::popcount(board.pieces(PieceType::ROOK, BLACK))
-                 + 9 * builtin::popcount(board.pieces(PieceType::QUEEN, BLACK));
-
-  // Detect white doubled pawns
-  float wEval = -builtin::popcount(wPawns & (wPawns >> 8))*.5f
-              +  wMaterial;
-
-  // Detect black doubled pawns
-  float bEval = -builtin::popcount(bPawns & (bPawns << 8))*.5f
-              +  bMaterial;
-
-  float eval = (board.sideToMove() == WHITE) ? wEval/bEval : bEval/wEval;
-
-  float mobility = static_cast<float>(legalmoves.size()) / opponentmoves.size();
-
-  return std::log2(eval * mobility);
+// epd <file> [movetime <ms>] [nodes <n>] [depth <d>] [threads <n>]
+void epdCommand(std::istream &args, int threads) {
+  std::string path;
+  std::string token;
+  Limits limits;
+  args >> path;
+  while (args >> token) {
+    if (token == "movetime") {
+      args >> limits.movetime;
+    } else if (token == "nodes") {
+      args >> limits.nodes;
+    } else if (token == "depth") {
+      args >> limits.depth;
+    } else if (token == "threads") {
+      args >> threads;
+    }
+  }
+  if (!limits.movetime && !limits.nodes && !limits.depth) {
+    limits.movetime = 1000;
+  }
+  runEpd(path, limits, std::max(1, threads));
 }
 
-Move start_negamax(Board board, int depth) {
-  Movelist moves;
-  movegen::legalmoves(moves, board);
-  float bestEval = -999;
-  Move bestMove = NULL;
-
-  for (int i = 0; i < moves.size(); i++) {
-    const Move move = moves[i];
-    board.makeMove(move);
-    float eval = -negamax(board, depth - 1, -999, 999);
-    board.unmakeMove(move);
-    if (eval > bestEval) {
-      bestEval = eval;
-      bestMove = move;
+// match <openings> [games <n>] [nodes|movetime|depth <x>]
+//       [basenodes|basemovetime|basedepth <x>] [elo0 <e>] [elo1 <e>]
+//       [alpha <a>] [beta <b>] [threads <n>]
+// Limits without the base prefix apply to both configurations unless the
+// base configuration is given its own.
+void matchCommand(std::istream &args, int threads) {
+  MatchSettings settings;
+  Limits base;
+  bool baseSet = false;
+  std::string token;
+  args >> settings.openings;
+  while (args >> token) {
+    if (token == "games") {
+      args >> settings.games;
+    } else if (token == "nodes") {
+      args >> settings.test.nodes;
+    } else if (token == "movetime") {
+      args >> settings.test.movetime;
+    } else if (token == "depth") {
+      args >> settings.test.depth;
+    } else if (token == "basenodes") {
+      args >> base.nodes;
+      baseSet = true;
+    } else if (token == "basemovetime") {
+      args >> base.movetime;
+      baseSet = true;
+    } else if (token == "basedepth") {
+      args >> base.depth;
+      baseSet = true;
+    } else if (token == "elo0") {
+      args >> settings.elo0;
+    } else if (token == "elo1") {
+      args >> settings.elo1;
+    } else if (token == "alpha") {
+      args >> settings.alpha;
+    } else if (token == "beta") {
+      args >> settings.beta;
+    } else if (token == "threads") {
+      args >> threads;
     }
   }
-
-  std::cout << "info string eval: " << bestEval << std::endl;
-
-  return bestMove;
+  if (!settings.test.nodes && !settings.test.movetime && !settings.test.depth) {
+    settings.test.nodes = 2000;
+  }
+  settings.base = baseSet ? base : settings.test;
+  settings.threads = std::max(1, threads);
+  runMatch(settings);
 }
 
-float negamax(Board board, int depth, float alpha, float beta) {
-  Movelist moves;
-  movegen::legalmoves(moves, board);
-
-  if (moves.empty()) {
-    if (board.inCheck()) {
-      return -999;
+int main(int argc, char *argv[]) {
+  // "main bench [depth]" runs the benchmark without entering the UCI loop
+  if (argc > 1 && std::string(argv[1]) == "bench") {
+    bench(argc > 2 ? std::stoi(argv[2]) : BENCH_DEPTH);
+    return 0;
+  }
+  // "main epd <file> ..." runs a test suite on all cores by default
+  if (argc > 1 && std::string(argv[1]) == "epd") {
+    std::stringstream args;
+    for (int i = 2; i < argc; i++) {
+      args << argv[i] << ' ';
     }
+    epdCommand(args, std::thread::hardware_concurrency());
     return 0;
   }
-  
-  if (depth == 0) {
-    board.makeNullMove();
-    Movelist enemymoves;
-    movegen::legalmoves(enemymoves, board);
-    board.unmakeNullMove();
-    return eval(board, moves, enemymoves);
+  if (argc > 1 && std::string(argv[1]) == "match") {
+    std::stringstream args;
+    for (int i = 2; i < argc; i++) {
+      args << argv[i] << ' ';
+    }
+    matchCommand(args, std::thread::hardware_concurrency());
+    return 0;
   }
 
-  for (int i = 0; i < moves.size(); i++) {
-    const Move move = moves[i];
-    board.makeMove(move);
-    float eval = -negamax(board, depth - 1, -beta, -alpha);
-    board.unmakeMove(move);
-    if (eval >= beta) {
-      return beta;
+  // Block on stdin in a dedicated thread instead of polling it, so commands are
+  // handed to the dispatcher as soon as they arrive. EOF is treated as quit.
+  std::thread reader([]() {
+    std::string line;
+    bool open = true;
+    while (open) {
+      open = static_cast<bool>(std::getline(std::cin, line));
+      {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        commands.push_back(open ? std::move(line) : "quit");
+      }
+      queueSignal.notify_one();
+    }
+  });
+  reader.detach(); // May still be blocked in getline() when we quit
+
+  TranspositionTable tt;
+  tt.resize(DEFAULT_HASH, 1);
+  Search searcher;
+  searcher.tt = &tt;
+  std::thread searchThread;
+  bool waitForStop = false; // "go infinite" only reports on "stop"
+  std::string stdin;
+  std::string command;
+
+  Board board;
+  std::string positionBase; // Last position command, see setPosition()
+  std::string positionMoves;
+  // Threads of perft, epd, match and hash clearing. The search itself is
+  // single threaded, so the option is not called Threads.
+  int threads = 1;
+  const int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  bool running = true;
+  bool searching = false;
+
+  // Wait for the search thread to finish and report its move
+  auto finishSearch = [&]() {
+    searchThread.join();
+    Move bestMove;
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      searchFinished = false;
+      bestMove = searchResult;
+    }
+    searching = false;
+    waitForStop = false;
+    sendLine("bestmove " +
+             (bestMove == Move::NO_MOVE ? "0000" : uci::moveToUci(bestMove)));
+  };
+
+  while (running) {
+    {
+      // Sleep until there is something to do; an idle engine uses no CPU
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queueSignal.wait(lock, [&]() {
+        return !commands.empty() || (searchFinished && !waitForStop);
+      });
+      if (commands.empty()) {
+        lock.unlock();
+        finishSearch();
+        continue;
+      }
+      stdin = std::move(commands.front());
+      commands.pop_front();
     }
-    alpha = std::max(alpha, eval);
-  }
 
-  return alpha;
-}
\ No newline at end of file
+    std::istringstream commandline(stdin);
+    command.clear();
+    commandline >> command;
+    if (command.empty()) {
+      continue; // Blank line
+    } else if (command == "uci") {
+      sendLine("id name Leo");
+      sendLine("option name Hash type spin default " + std::to_string(DEFAULT_HASH) +
+               " min 1 max " + std::to_string(MAX_HASH));
+      sendLine("option name UtilityThreads type spin default 1 min 1 max " +
+               std::to_string(maxThreads));
+      sendLine("option name NumaBind type check default false");
+      sendLine("uciok");
+    } else if (command == "isready") {
+      sendLine("readyok");
+    } else if (command == "position") {
+      std::string_view args(stdin);
+      nextToken(args); // "position"
+      setPosition(args, board, positionBase, positionMoves);
+    } else if (command == "setoption") {
+      // setoption name <id> value <x>
+      std::string name;
+      std::string value;
+      commandline >> command;
+      while (commandline >> command && command != "value") {
+        name += (name.empty() ? "" : " ") + command;
+      }
+      commandline >> value;
+      int64_t number = 0;
+      if (searching) {
+        sendLine("info string cannot change options while searching");
+      } else if ((name == "Hash" || name == "UtilityThreads") &&
+                 !parseInteger(value, number)) {
+        sendLine("info string invalid value for " + name);
+      } else if (name == "NumaBind" && value != "true" && value != "false") {
+        sendLine("info string invalid value for " + name);
+      } else if (name == "Hash") {
+        tt.resize(std::clamp<int64_t>(number, 1, MAX_HASH), threads);
+      } else if (name == "NumaBind") {
+        setNumaBinding(value == "true");
+        if (value == "true") {
+          sendLine("info string " + std::to_string(numaNodes()) + " NUMA node(s)");
+        }
+      } else if (name == "UtilityThreads") {
+        threads = static_cast<int>(std::clamp<int64_t>(number, 1, maxThreads));
+      } else {
+        sendLine("info string unknown option " + name);
+      }
+    } else if (command == "ucinewgame") {
+      if (searching) {
+        searcher.stopped = true;
+        finishSearch();
+      }
+      tt.clear(threads); // The next game must not see results of this one
+    } else if (command == "go") {
+      if (searching) {
+        searcher.stopped = true;
+        finishSearch();
+      }
+      Limits limits;
+      bool searchmoves = false; // Following move tokens restrict the root
+      bool perftOnly = false;
+      while (commandline >> command) {
+        if (command == "perft" || command == "divide") {
+          int depth = 1;
+          commandline >> depth;
+          perft(board, depth, threads, command == "divide");
+          perftOnly = true;
+          break;
+        } else if (command == "depth") {
+          commandline >> limits.depth;
+        } else if (command == "nodes") {
+          commandline >> limits.nodes;
+        } else if (command == "movetime") {
+          commandline >> limits.movetime;
+        } else if (command == "wtime") {
+          commandline >> limits.time[0];
+        } else if (command == "btime") {
+          commandline >> limits.time[1];
+        } else if (command == "winc") {
+          commandline >> limits.inc[0];
+        } else if (command == "binc") {
+          commandline >> limits.inc[1];
+        } else if (command == "movestogo") {
+          commandline >> limits.movestogo;
+        } else if (command == "infinite") {
+          limits.infinite = true;
+        } else if (command == "searchmoves") {
+          searchmoves = true;
+        } else if (searchmoves) {
+          limits.searchmoves.add(uci::uciToMove(board, command));
+        }
+      }
+      if (perftOnly) {
+        continue;
+      }
+      waitForStop = limits.infinite;
+      searcher.stopped = false;
+      // The search thread works on its own copy of the board and wakes the
+      // dispatcher once it has a result
+      searchThread = std::thread([&searcher, board, limits]() {
+        bindThreadToNode(0);
+        Move bestMove = searcher.start(board, limits);
+        {
+          std::lock_guard<std::mutex> lock(queueMutex);
+          searchResult = bestMove;
+          searchFinished = true;
+        }
+        queueSignal.notify_one();
+      });
+      searching = true;
+    } else if (command == "stop") {
+      if (searching) {
+        searcher.stopped = true;
+        finishSearch();
+      }
+    } else if (command == "bench") {
+      int depth = BENCH_DEPTH;
+      commandline >> depth;
+      if (searching) {
+        sendLine("info string cannot bench while searching");
+      } else {
+        bench(depth);
+      }
+    } else if (command == "epd") {
+      if (searching) {
+        sendLine("info string cannot run a test suite while searching");
+      } else {
+        epdCommand(commandline, threads);
+      }
+    } else if (command == "match") {
+      if (searching) {
+        sendLine("info string cannot run a match while searching");
+      } else {
+        matchCommand(commandline, threads);
+      }
+    } else if (command == "stats") {
+#ifdef STATS
+      if (searching) {
+        sendLine("info string stats are available once the search finished");
+      } else {
+        sendLine(searcher.stats.report(commandline >> command && command == "json"));
+      }
+#else
+      sendLine("info string stats are not compiled in, build with make main-stats");
+#endif
+    } else if (command == "quit") {
+      if (searching) {
+        searcher.stopped = true;
+        finishSearch();
+      }
+      running = false;
+    } else {
+      sendLine("info string unknown command " + command); // Ignored as UCI requires
+    }
+  }
+  return 0;
+}
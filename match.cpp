@@ -0,0 +1,265 @@
+#include "match.h"
+#include "numa.h"
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+using namespace chess;
+
+constexpr int MAX_GAME_PLIES = 400; // Longer games are scored as draws
+constexpr float RESIGN_EVAL = 4;    // Adjudicate a win once both sides agree
+constexpr int RESIGN_PLIES = 8;     // on a score this large for this long
+constexpr float DRAW_EVAL = 0.1f;   // Adjudicate a draw once the score stays
+constexpr int DRAW_PLIES = 12;      // this close to zero for this long,
+constexpr int DRAW_MIN_PLY = 80;    // but not in the opening or middlegame
+
+// Collects the position at the end of each game of a PGN file
+class OpeningVisitor : public pgn::Visitor {
+public:
+  explicit OpeningVisitor(std::vector<std::string> &openings)
+      : openings(openings) {}
+
+  void startPgn() override { board.setFen(constants::STARTPOS); }
+
+  void header(std::string_view key, std::string_view value) override {
+    if (key == "FEN") {
+      board.setFen(value);
+    }
+  }
+
+  void startMoves() override {}
+
+  void move(std::string_view san, std::string_view) override {
+    if (!san.empty()) {
+      board.makeMove(uci::parseSan(board, san));
+    }
+  }
+
+  void endPgn() override { openings.push_back(board.getFen()); }
+
+private:
+  std::vector<std::string> &openings;
+  Board board;
+};
+
+static std::vector<std::string> readOpenings(const std::string &path) {
+  std::vector<std::string> openings;
+  std::ifstream file(path);
+  if (path.size() > 4 && path.substr(path.size() - 4) == ".pgn") {
+    OpeningVisitor visitor(openings);
+    try {
+      pgn::StreamParser(file).readGames(visitor);
+    } catch (const uci::SanParseError &error) {
+      sendLine(std::string("info string ") + error.what());
+    }
+    return openings;
+  }
+
+  // EPD, only the four FEN fields of each line are used
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string fen;
+    std::string field;
+    for (int i = 0; i < 4 && fields >> field; i++) {
+      fen += (i ? " " : "") + field;
+    }
+    if (!fen.empty()) {
+      openings.push_back(fen);
+    }
+  }
+  return openings;
+}
+
+struct Player {
+  Search search;
+  Limits limits;
+  TranspositionTable tt;
+};
+
+// Play one game and return the score of white
+static float playGame(const std::string &fen, Player &white, Player &black) {
+  Board board(fen);
+  white.tt.clear(1);
+  black.tt.clear(1);
+  int resignCount = 0; // Positive while white is winning, negative for black
+  int drawCount = 0;
+
+  for (int ply = 0; ply < MAX_GAME_PLIES; ply++) {
+    auto [reason, result] = board.isGameOver();
+    if (reason != GameResultReason::NONE) {
+      if (result == GameResult::DRAW) {
+        return 0.5f;
+      }
+      return board.sideToMove() == Color::WHITE ? 0 : 1;
+    }
+
+    const bool whiteToMove = board.sideToMove() == Color::WHITE;
+    Player &player = whiteToMove ? white : black;
+    player.search.stopped = false;
+    const Move move = player.search.start(board, player.limits);
+    board.makeMove(move);
+
+    const std::vector<Iteration> &iterations = player.search.iterations();
+    if (iterations.empty()) {
+      resignCount = drawCount = 0;
+      continue;
+    }
+    const float eval = whiteToMove ? iterations.back().eval
+                                   : -iterations.back().eval;
+    if (eval >= RESIGN_EVAL) {
+      resignCount = std::max(resignCount, 0) + 1;
+    } else if (eval <= -RESIGN_EVAL) {
+      resignCount = std::min(resignCount, 0) - 1;
+    } else {
+      resignCount = 0;
+    }
+    drawCount = ply >= DRAW_MIN_PLY && std::abs(eval) <= DRAW_EVAL ? drawCount + 1 : 0;
+
+    if (resignCount >= RESIGN_PLIES) {
+      return 1;
+    }
+    if (resignCount <= -RESIGN_PLIES) {
+      return 0;
+    }
+    if (drawCount >= DRAW_PLIES) {
+      return 0.5f;
+    }
+  }
+  return 0.5f;
+}
+
+// Logistic Elo difference of an expected score
+static double scoreToElo(double score) {
+  score = std::clamp(score, 1e-6, 1 - 1e-6);
+  return -400 * std::log10(1 / score - 1);
+}
+
+static double eloToScore(double elo) {
+  return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+// Game pair results counted by the points the test configuration scored in
+// the pair: 0, 0.5, 1, 1.5 or 2
+struct Pentanomial {
+  uint64_t pairs[5] = {};
+  int wins = 0;
+  int losses = 0;
+  int draws = 0;
+
+  uint64_t count() const {
+    return pairs[0] + pairs[1] + pairs[2] + pairs[3] + pairs[4];
+  }
+
+  // Mean and variance of the pair score, scaled to [0, 1]. A small prior in
+  // every bin keeps the variance positive when all pairs ended alike.
+  void moments(double &mean, double &variance) const {
+    constexpr double PRIOR = 1e-3;
+    const double n = count() + 5 * PRIOR;
+    mean = variance = 0;
+    for (int i = 0; i < 5; i++) {
+      mean += i / 4.0 * (pairs[i] + PRIOR) / n;
+    }
+    for (int i = 0; i < 5; i++) {
+      variance += (i / 4.0 - mean) * (i / 4.0 - mean) * (pairs[i] + PRIOR) / n;
+    }
+  }
+
+  // Log-likelihood ratio of H1 against H0 under the normal approximation
+  double llr(double elo0, double elo1) const {
+    double mean;
+    double variance;
+    moments(mean, variance);
+    const double s0 = eloToScore(elo0);
+    const double s1 = eloToScore(elo1);
+    return count() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+  }
+};
+
+void runMatch(const MatchSettings &settings) {
+  const std::vector<std::string> openings = readOpenings(settings.openings);
+  if (openings.empty()) {
+    sendLine("info string no openings found in " + settings.openings);
+    return;
+  }
+
+  const double lower = std::log(settings.beta / (1 - settings.alpha));
+  const double upper = std::log((1 - settings.beta) / settings.alpha);
+  const int pairs = (settings.games + 1) / 2;
+  Pentanomial results;
+  std::mutex resultsMutex;
+  std::atomic<int> next{0};
+  std::atomic<bool> decided{false};
+  const auto startTime = std::chrono::steady_clock::now();
+
+  auto report = [&]() {
+    double mean;
+    double variance;
+    results.moments(mean, variance);
+    const double margin = 1.96 * std::sqrt(variance / results.count());
+    const double llr = results.llr(settings.elo0, settings.elo1);
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << "Games "
+         << results.wins + results.losses + results.draws << ": +"
+         << results.wins << " -" << results.losses << " =" << results.draws
+         << " Elo " << scoreToElo(mean) << " +- "
+         << (scoreToElo(mean + margin) - scoreToElo(mean - margin)) / 2
+         << std::setprecision(2) << " LLR " << llr << " [" << lower << ", "
+         << upper << "]";
+    sendLine(line.str());
+    return llr;
+  };
+
+  // Every worker plays whole game pairs so both games of an opening are
+  // counted together
+  auto worker = [&](int index) {
+    bindThreadToNode(index); // Before the tables are allocated and touched
+    Player test{Search(), settings.test, {}};
+    Player base{Search(), settings.base, {}};
+    for (Player *player : {&test, &base}) {
+      player->tt.resize(DEFAULT_HASH, 1);
+      player->search.silent = true;
+      player->search.tt = &player->tt;
+    }
+    for (int i = next++; i < pairs && !decided; i = next++) {
+      const std::string &fen = openings[i % openings.size()];
+      const float first = playGame(fen, test, base);
+      const float second = 1 - playGame(fen, base, test);
+
+      std::lock_guard<std::mutex> lock(resultsMutex);
+      for (const float score : {first, second}) {
+        results.wins += score == 1;
+        results.losses += score == 0;
+        results.draws += score == 0.5f;
+      }
+      results.pairs[static_cast<int>(2 * (first + second))]++;
+      const double llr = report();
+      if (llr <= lower || llr >= upper) {
+        decided = true;
+      }
+    }
+  };
+  // Even the first worker gets its own thread, binding the caller to a node
+  // would restrict it and every thread it creates later
+  std::vector<std::thread> pool;
+  for (int i = 0; i < settings.threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+
+  const double llr = results.llr(settings.elo0, settings.elo1);
+  const int64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - startTime)
+                           .count();
+  sendLine("===========================");
+  sendLine(std::string(llr >= upper   ? "H1 accepted"
+                       : llr <= lower ? "H0 accepted"
+                                      : "SPRT undecided") +
+           " after " + std::to_string(2 * results.count()) + " games in " +
+           std::to_string(time) + " ms");
+}
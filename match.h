@@ -0,0 +1,27 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "search.h"
+#include <string>
+
+// Settings of a self-play match between a test and a base configuration of
+// the engine. Both play with their own search limits.
+struct MatchSettings {
+  std::string openings; // EPD or PGN file, every opening is played twice
+  Limits test;
+  Limits base;
+  int games = 1000; // Upper bound, the SPRT usually stops the match earlier
+  int threads = 1;  // Games played in parallel
+  float elo0 = 0;   // SPRT hypotheses and error probabilities
+  float elo1 = 5;
+  float alpha = 0.05f;
+  float beta = 0.05f;
+};
+
+// Play pairs of games with swapped colors from each opening inside this
+// process, adjudicate finished and hopeless games, and run a sequential
+// probability ratio test on the game pair results until H0 (test is not
+// better than elo0) or H1 (test is at least elo1 stronger) is accepted.
+void runMatch(const MatchSettings &settings);
+
+#endif
@@ -0,0 +1,102 @@
+#include "numa.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#if defined(__linux__)
+#include <fstream>
+#include <sched.h>
+#include <string>
+#endif
+
+static std::atomic<bool> binding{false};
+
+#if defined(__linux__)
+
+// Parse a kernel CPU list such as "0-15,32-47"
+static std::vector<int> parseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    const std::string range = list.substr(pos, end - pos);
+    const size_t dash = range.find('-');
+    try {
+      const int first = std::stoi(range);
+      const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::exception &) {
+      // Trailing newline or an empty list
+    }
+    pos = end + 1;
+  }
+  return cpus;
+}
+
+// CPUs of every node with CPUs, read once
+static const std::vector<std::vector<int>> &topology() {
+  static const std::vector<std::vector<int>> nodes = [] {
+    std::vector<std::vector<int>> result;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (!std::getline(online, list)) {
+      return result;
+    }
+    for (const int node : parseCpuList(list)) {
+      std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) +
+                         "/cpulist");
+      std::string cpus;
+      if (std::getline(file, cpus) && !parseCpuList(cpus).empty()) {
+        result.push_back(parseCpuList(cpus));
+      }
+    }
+    return result;
+  }();
+  return nodes;
+}
+
+int numaNodes() { return std::max<int>(1, topology().size()); }
+
+// Affinity of the process at startup, taken on the main thread during static
+// initialization before any thread could be bound
+static const cpu_set_t startMask = [] {
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  sched_getaffinity(0, sizeof(mask), &mask);
+  return mask;
+}();
+
+void bindThreadToNode(int index) {
+  if (!binding || numaNodes() < 2) {
+    return;
+  }
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (const int cpu : topology()[index % numaNodes()]) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &mask);
+    }
+  }
+  sched_setaffinity(0, sizeof(mask), &mask); // Best effort, 0 is this thread
+}
+
+void setNumaBinding(bool enabled) {
+  binding = enabled;
+  if (!enabled) {
+    sched_setaffinity(0, sizeof(startMask), &startMask);
+  }
+}
+
+#else
+
+int numaNodes() { return 1; }
+
+void bindThreadToNode(int) {}
+
+void setNumaBinding(bool enabled) { binding = enabled; }
+
+#endif
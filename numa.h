@@ -0,0 +1,20 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+// Placement of worker threads on NUMA nodes. The topology is read from /sys
+// on Linux. On single node machines, other platforms, or while binding is
+// disabled every function here is a no-op.
+
+// Number of NUMA nodes that have CPUs, 1 if it cannot be determined
+int numaNodes();
+
+// Set by the NumaBind option, off by default. Disabling it also gives the
+// calling thread back the CPUs the process started with.
+void setNumaBinding(bool enabled);
+
+// Restrict the calling thread to the CPUs of one node. Workers pass their
+// index within their pool, so a pool is spread evenly over the nodes and
+// whatever a worker allocates and touches first stays on its own node.
+void bindThreadToNode(int index);
+
+#endif
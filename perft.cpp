@@ -0,0 +1,152 @@
+#include "perft.h"
+#include "numa.h"
+#include "search.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+using namespace chess;
+
+// Subtree counts keyed on position and depth, shared by all perft threads
+// without locking. Each entry stores its key XORed with its data, so an entry
+// torn by a concurrent write fails verification instead of returning a wrong
+// count.
+class PerftTable {
+public:
+  explicit PerftTable(size_t sizeLog2)
+      : entries(new Entry[size_t(1) << sizeLog2]),
+        mask((size_t(1) << sizeLog2) - 1) {}
+
+  bool probe(U64 key, int depth, uint64_t &count) const {
+    const Entry &entry = entries[key & mask];
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t check = entry.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || (data & 0xFF) != uint64_t(depth)) {
+      return false;
+    }
+    count = data >> 8;
+    return true;
+  }
+
+  void store(U64 key, int depth, uint64_t count) {
+    Entry &entry = entries[key & mask];
+    const uint64_t data = (count << 8) | uint64_t(depth);
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    std::atomic<uint64_t> check{0};
+    std::atomic<uint64_t> data{0}; // Count in the upper 56 bits, depth below
+  };
+
+  std::unique_ptr<Entry[]> entries;
+  size_t mask;
+};
+
+constexpr size_t PERFT_TABLE_SIZE_LOG2 = 22; // 64 MB
+constexpr int PERFT_TABLE_MIN_DEPTH = 4;      // Shallower trees run without one
+
+// Subtree counts never go stale, so the table is allocated on first use and
+// then shared by all later perft calls
+static PerftTable &perftTable() {
+  static PerftTable table(PERFT_TABLE_SIZE_LOG2);
+  return table;
+}
+
+static uint64_t perftNode(Board &board, int depth, PerftTable *table) {
+  uint64_t count = 0;
+  if (table && depth >= 2 && table->probe(board.hash(), depth, count)) {
+    return count;
+  }
+
+  // Bulk counting: the last ply only needs the number of moves
+  if (depth == 1) {
+    return movegen::countLegal(board);
+  }
+
+  Movelist moves;
+  movegen::legalmoves(moves, board);
+
+  // The children of the last but one ply are counted in batches, one position
+  // per vector lane. Without vector lanes counting one by one is faster.
+  if (depth == 2 && movegen::BATCH_LANES > 1) {
+    const Position parent(board);
+    Position children[constants::MAX_MOVES];
+    movegen::LegalTargets targets[constants::MAX_MOVES];
+    for (int i = 0; i < moves.size(); i++) {
+      parent.apply(moves[i], children[i]);
+    }
+    movegen::legalTargets(children, targets, moves.size());
+    for (int i = 0; i < moves.size(); i++) {
+      count += targets[i].count;
+    }
+    if (table) {
+      table->store(board.hash(), depth, count);
+    }
+    return count;
+  }
+
+  for (const Move move : moves) {
+    board.makeMove(move);
+    count += perftNode(board, depth - 1, table);
+    board.unmakeMove(move);
+  }
+
+  if (table) {
+    table->store(board.hash(), depth, count);
+  }
+  return count;
+}
+
+uint64_t perft(const Board &board, int depth, int threads, bool divide) {
+  if (depth <= 0) {
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  Movelist rootMoves;
+  movegen::legalmoves(rootMoves, board);
+
+  PerftTable *table = depth >= PERFT_TABLE_MIN_DEPTH ? &perftTable() : nullptr;
+  std::vector<uint64_t> counts(rootMoves.size());
+  std::atomic<int> nextMove{0};
+
+  // Every thread works on its own board and picks the next unclaimed root
+  // move until none are left, which balances unevenly sized subtrees
+  auto worker = [&](int index) {
+    bindThreadToNode(index);
+    Board local = board;
+    for (int i = nextMove++; i < rootMoves.size(); i = nextMove++) {
+      local.makeMove(rootMoves[i]);
+      counts[i] = depth == 1 ? 1 : perftNode(local, depth - 1, table);
+      local.unmakeMove(rootMoves[i]);
+    }
+  };
+
+  // Even the first worker gets its own thread, binding the caller to a node
+  // would restrict it and every thread it creates later
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(worker, i);
+  }
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+
+  uint64_t total = 0;
+  for (int i = 0; i < rootMoves.size(); i++) {
+    total += counts[i];
+    if (divide) {
+      sendLine(uci::moveToUci(rootMoves[i]) + ": " + std::to_string(counts[i]));
+    }
+  }
+
+  auto time = std::chrono::steady_clock::now() - start;
+  int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+  sendLine("info nodes " + std::to_string(total) + " time " + std::to_string(ms) +
+           " nps " + std::to_string(total * 1000 / std::max<int64_t>(1, ms)));
+  return total;
+}
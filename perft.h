@@ -0,0 +1,12 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "chess.hpp"
+#include <cstdint>
+
+// Count the leaf nodes of the legal move tree of the given depth. Root moves
+// are shared out between the threads, which cache subtree counts in a common
+// hash table. With divide the count below every root move is printed too.
+uint64_t perft(const chess::Board &board, int depth, int threads, bool divide);
+
+#endif
@@ -0,0 +1,370 @@
+#include "search.h"
+#include <cmath>
+#include <mutex>
+#include <sstream>
+using namespace chess;
+
+constexpr int DEFAULT_DEPTH = 5; // Used when "go" sets no limit at all
+constexpr float MATE = 999;      // Score of being mated at the root
+constexpr float MAX_EVAL = 100;  // Static evaluations stay far below mate scores
+constexpr int64_t INFO_INTERVAL = 100;     // Min. milliseconds between infos
+constexpr int64_t PROGRESS_INTERVAL = 1000; // Infos within a long iteration
+
+void sendLine(const std::string &line) {
+  static std::mutex outputMutex;
+  std::lock_guard<std::mutex> lock(outputMutex);
+  std::cout << line << std::endl;
+}
+
+// Mate scores are reported in moves, everything else in centipawns
+static std::string scoreToUci(float eval) {
+  if (std::abs(eval) >= MATE - MAX_PLY && std::abs(eval) <= MATE) {
+    int plies = static_cast<int>(MATE - std::abs(eval));
+    int moves = (plies + 1) / 2;
+    return "mate " + std::to_string(eval > 0 ? moves : -moves);
+  }
+  return "cp " + std::to_string(std::lround(std::clamp(eval, -MAX_EVAL, MAX_EVAL) * 100));
+}
+
+float eval(const Board &board, const Movelist &legalmoves,
+           const Movelist &opponentmoves) {
+  constexpr auto WHITE = Color::WHITE; // alias
+  constexpr auto BLACK = Color::BLACK; // alias
+  const bool white = board.sideToMove() == WHITE;
+  Bitboard wPawns = board.pieces(PieceType::PAWN, WHITE);
+  Bitboard bPawns = board.pieces(PieceType::PAWN, BLACK);
+  uint wMaterial = 1 * builtin::popcount(wPawns)
+                 + 3 * builtin::popcount(board.pieces(PieceType::KNIGHT, WHITE)|
+                                         board.pieces(PieceType::BISHOP, WHITE))
+                 + 5 * builtin::popcount(board.pieces(PieceType::ROOK, WHITE))
+                 + 9 * builtin::popcount(board.pieces(PieceType::QUEEN, WHITE));
+  uint bMaterial = 1 * builtin::popcount(bPawns)
+                 + 3 * builtin::popcount(board.pieces(PieceType::KNIGHT, BLACK)|
+                                         board.pieces(PieceType::BISHOP, BLACK))
+                 + 5 * builtin::popcount(board.pieces(PieceType::ROOK, BLACK))
+                 + 9 * builtin::popcount(board.pieces(PieceType::QUEEN, BLACK));
+
+  // Detect white doubled pawns
+  float wEval = -builtin::popcount(wPawns & (wPawns >> 8))*.5f
+              +  wMaterial;
+
+  // Detect black doubled pawns
+  float bEval = -builtin::popcount(bPawns & (bPawns << 8))*.5f
+              +  bMaterial;
+
+  // Both ratios below are undefined once a side has no material or no moves
+  // left. Checked up front, -ffast-math assumes there are no infinities.
+  if (!wMaterial || !bMaterial) {
+    const uint ours = white ? wMaterial : bMaterial;
+    const uint theirs = white ? bMaterial : wMaterial;
+    return ours == theirs ? 0 : ours > theirs ? MAX_EVAL : -MAX_EVAL;
+  }
+  if (opponentmoves.empty()) {
+    return MAX_EVAL;
+  }
+
+  float eval = white ? wEval/bEval : bEval/wEval;
+
+  float mobility = static_cast<float>(legalmoves.size()) / opponentmoves.size();
+
+  return std::log2(eval * mobility);
+}
+
+Move Search::start(Board board, const Limits &searchLimits) {
+  limits = searchLimits;
+  nodes = 0;
+  completed.clear();
+  STAT(stats = SearchStats());
+  if (tt) {
+    tt->newSearch();
+  }
+  startTime = std::chrono::steady_clock::now();
+  lastInfoTime = 0;
+
+  // Spend the fixed move time, or a share of the remaining clock time
+  const int us = static_cast<int>(board.sideToMove());
+  timeBudget = limits.movetime;
+  if (!timeBudget && limits.time[us] > 0) {
+    int movestogo = limits.movestogo ? limits.movestogo : 30;
+    timeBudget = limits.time[us] / movestogo + limits.inc[us] / 2;
+    timeBudget = std::max<int64_t>(1, std::min(timeBudget, limits.time[us] - 50));
+  }
+
+  int maxDepth = DEFAULT_DEPTH;
+  if (limits.depth) {
+    maxDepth = std::min(limits.depth, MAX_DEPTH);
+  } else if (limits.nodes || timeBudget || limits.infinite) {
+    maxDepth = MAX_DEPTH;
+  }
+
+  Movelist rootMoves;
+  Movelist legal;
+  movegen::legalmoves(legal, board);
+  for (const Move move : legal) {
+    if (limits.searchmoves.empty() || limits.searchmoves.find(move) != -1) {
+      rootMoves.add(move);
+    }
+  }
+  if (rootMoves.empty()) {
+    return Move::NO_MOVE;
+  }
+
+  // Fall back to any root move in case the first iteration does not complete
+  Move bestMove = rootMoves[0];
+  std::string pendingInfo; // Last iteration, if it was not reported yet
+  for (rootDepth = 1; rootDepth <= maxDepth; rootDepth++) {
+    seldepth = 0;
+    STAT(const uint64_t iterationStart = nodes);
+    Move iterationMove = bestMove;
+    float eval = rootSearch(board, rootMoves, iterationMove);
+    if (stopped) {
+      break; // Results of an interrupted iteration are unreliable
+    }
+    STAT(stats.iterationNodes.push_back(nodes - iterationStart));
+    bestMove = iterationMove;
+    completed.push_back({rootDepth, bestMove, eval, elapsed(), nodes});
+
+    // Skip reporting iterations that finish in quick succession
+    pendingInfo = iterationInfo(eval);
+    if (silent) {
+      pendingInfo.clear();
+    } else if (lastInfoTime == 0 || elapsed() - lastInfoTime >= INFO_INTERVAL) {
+      sendLine(pendingInfo);
+      pendingInfo.clear();
+      lastInfoTime = std::max<int64_t>(1, elapsed());
+    }
+  }
+
+  if (!pendingInfo.empty()) {
+    sendLine(pendingInfo);
+  }
+  STAT(stats.nodes = nodes);
+
+  return bestMove;
+}
+
+float Search::rootSearch(Board &board, const Movelist &rootMoves,
+                         Move &bestMove) {
+  float bestEval = -1000;
+  pvLength[0] = 0;
+
+  for (int i = 0; i < rootMoves.size(); i++) {
+    const Move move = rootMoves[i];
+    if (tt) {
+      tt->prefetch(board.hashAfter(move));
+    }
+    board.makeMove(move);
+    float eval = -negamax(board, rootDepth - 1, 1, -MATE, MATE);
+    board.unmakeMove(move);
+    if (stopped) {
+      break;
+    }
+    if (eval > bestEval) {
+      bestEval = eval;
+      bestMove = move;
+      updatePv(0, move);
+    }
+  }
+
+  return bestEval;
+}
+
+// Mate scores are stored relative to the node, so they stay correct when the
+// position is reached again at a different ply
+static float toTT(float eval, int ply) {
+  return eval >= MATE - MAX_PLY ? eval + ply : eval <= -MATE + MAX_PLY ? eval - ply : eval;
+}
+
+static float fromTT(float eval, int ply) {
+  return eval >= MATE - MAX_PLY ? eval - ply : eval <= -MATE + MAX_PLY ? eval + ply : eval;
+}
+
+float Search::negamax(Board &board, int depth, int ply, float alpha, float beta) {
+  pvLength[ply] = ply;
+  if (outOfLimits()) {
+    return 0;
+  }
+
+  TTData hit;
+  Move ttMove = Move::NO_MOVE;
+  STAT(stats.ttProbes += tt != nullptr);
+  if (tt && tt->probe(board.hash(), hit)) {
+    STAT(stats.ttHits++);
+    ttMove = hit.move;
+    const float ttEval = fromTT(hit.eval, ply);
+    if (hit.depth >= depth) {
+      if (hit.bound == Bound::EXACT && ttEval > alpha && ttEval < beta) {
+        STAT(stats.ttCutoffs++);
+        if (ttMove != Move::NO_MOVE) {
+          pvTable[ply][ply] = ttMove;
+          pvLength[ply] = ply + 1;
+        }
+        return ttEval;
+      }
+      if ((hit.bound == Bound::EXACT || hit.bound == Bound::LOWER) && ttEval >= beta) {
+        STAT(stats.ttCutoffs++);
+        return beta;
+      }
+      if ((hit.bound == Bound::EXACT || hit.bound == Bound::UPPER) && ttEval <= alpha) {
+        STAT(stats.ttCutoffs++);
+        return alpha;
+      }
+    }
+  }
+
+  seldepth = std::max(seldepth, ply); // Only nodes that are expanded count
+  const float originalAlpha = alpha;
+  Move bestMove = Move::NO_MOVE;
+  int searched = 0;
+
+  // Search a child, returns true on a beta cutoff or when the search stopped
+  auto searchMove = [&](Move move) {
+    if (tt) {
+      tt->prefetch(board.hashAfter(move)); // Hide the latency of the probe
+    }
+    board.makeMove(move);
+    const float eval = -negamax(board, depth - 1, ply + 1, -beta, -alpha);
+    board.unmakeMove(move);
+    if (stopped) {
+      return true;
+    }
+    if (eval >= beta) {
+      STAT(stats.betaCutoffs++);
+      STAT(stats.firstMoveCutoffs += (searched == 0));
+      STAT(stats.cutoffIndexSum += searched);
+      if (tt) {
+        tt->store(board.hash(), depth, toTT(beta, ply), Bound::LOWER, move);
+      }
+      return true;
+    }
+    if (eval > alpha) {
+      alpha = eval;
+      bestMove = move;
+      updatePv(ply, move);
+    }
+    searched++;
+    return false;
+  };
+
+  // The best move of an earlier visit is tried before generating any moves,
+  // when it fails high again move generation is skipped entirely
+  const bool hashMoveFirst = depth > 0 && ttMove != Move::NO_MOVE &&
+                             board.isPseudoLegal(ttMove) && board.isLegal(ttMove);
+  if (hashMoveFirst && searchMove(ttMove)) {
+    return stopped ? 0 : beta;
+  }
+
+  // Interior nodes compute their checkers, pins and attacked squares once and
+  // share them between move generation and move ordering
+  AttackInfo info;
+  Movelist moves;
+  if (depth > 0) {
+    info = board.attackInfo();
+    movegen::legalmoves(moves, board, info);
+  } else {
+    movegen::legalmoves(moves, board);
+  }
+
+  if (moves.empty()) {
+    if (board.inCheck()) {
+      return -MATE + ply; // Prefer the quickest mate
+    }
+    return 0;
+  }
+
+  if (depth == 0) {
+    STAT(stats.leafNodes++);
+    board.makeNullMove();
+    Movelist enemymoves;
+    movegen::legalmoves(enemymoves, board);
+    board.unmakeNullMove();
+    const float leafEval = eval(board, moves, enemymoves);
+    if (tt) {
+      tt->store(board.hash(), 0, leafEval, Bound::EXACT, Move::NO_MOVE);
+    }
+    return leafEval;
+  }
+
+  // Captures that do not lose material first, then checks, otherwise the
+  // generation order is kept
+  for (Move &move : moves) {
+    const bool capture = board.isCapture(move) || move.typeOf() == Move::PROMOTION;
+    move.setScore(capture && board.seeGe(move, 0, info) ? 2
+                  : board.givesCheck(move, info)          ? 1
+                                                          : 0);
+  }
+  moves.sort();
+
+  for (const Move move : moves) {
+    if (hashMoveFirst && move == ttMove) {
+      continue;
+    }
+    if (searchMove(move)) {
+      return stopped ? 0 : beta;
+    }
+  }
+
+  if (tt) {
+    tt->store(board.hash(), depth, toTT(alpha, ply),
+              alpha > originalAlpha ? Bound::EXACT : Bound::UPPER, bestMove);
+  }
+  return alpha;
+}
+
+// The principal variation of a node is its best move followed by the
+// principal variation of the child reached by that move
+void Search::updatePv(int ply, Move move) {
+  pvTable[ply][ply] = move;
+  for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+    pvTable[ply][i] = pvTable[ply + 1][i];
+  }
+  pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+}
+
+std::string Search::iterationInfo(float eval) const {
+  const int64_t time = elapsed();
+  std::ostringstream info;
+  // Hash cutoffs can end every line early, seldepth is never below depth
+  info << "info depth " << rootDepth << " seldepth " << std::max(seldepth, rootDepth)
+       << " score " << scoreToUci(eval) << " nodes " << nodes << " nps "
+       << nodes * 1000 / std::max<int64_t>(1, time);
+  if (tt) {
+    info << " hashfull " << tt->hashfull();
+  }
+  info << " time " << time << " pv";
+  for (int i = 0; i < pvLength[0]; i++) {
+    info << ' ' << uci::moveToUci(pvTable[0][i]);
+  }
+  return info.str();
+}
+
+int64_t Search::elapsed() const {
+  auto time = std::chrono::steady_clock::now() - startTime;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+}
+
+// Count the node and report whether the search has to be aborted. The node
+// limit is checked exactly so fixed-node searches are reproducible, the clock
+// only every 1024 nodes.
+bool Search::outOfLimits() {
+  nodes++;
+  if (stopped.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  if (limits.nodes && nodes > limits.nodes) {
+    stopped = true;
+  } else if ((nodes & 1023) == 0) {
+    const int64_t time = elapsed();
+    if (timeBudget && time >= timeBudget) {
+      stopped = true;
+    } else if (!silent && time - lastInfoTime >= PROGRESS_INTERVAL) {
+      // Keep the GUI informed during iterations that take a long time
+      sendLine("info depth " + std::to_string(rootDepth) + " nodes " +
+               std::to_string(nodes) + " nps " +
+               std::to_string(nodes * 1000 / std::max<int64_t>(1, time)) +
+               " time " + std::to_string(time));
+      lastInfoTime = time;
+    }
+  }
+  return stopped;
+}
@@ -0,0 +1,90 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "chess.hpp"
+#include "stats.h"
+#include "tt.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr int MAX_DEPTH = 64;
+constexpr int MAX_PLY = MAX_DEPTH + 1;
+
+// Write a complete line to stdout. Safe to call from any thread.
+void sendLine(const std::string &line);
+
+// Constraints on a search as given by the UCI "go" command. A limit that is
+// zero is not set.
+struct Limits {
+  int depth = 0;
+  uint64_t nodes = 0;
+  int64_t movetime = 0;     // Milliseconds
+  int64_t time[2] = {0, 0}; // Remaining clock time for white and black
+  int64_t inc[2] = {0, 0};
+  int movestogo = 0;
+  bool infinite = false;
+  chess::Movelist searchmoves; // Only search these root moves if not empty
+};
+
+// Outcome of one completed iteration of a search
+struct Iteration {
+  int depth;
+  chess::Move bestMove;
+  float eval;
+  int64_t time; // Milliseconds since the search started
+  uint64_t nodes;
+};
+
+class Search {
+public:
+  // Iteratively deepen until a limit is hit or the search is stopped and
+  // return the best move of the last completed iteration
+  chess::Move start(chess::Board board, const Limits &limits);
+
+  uint64_t searchedNodes() const { return nodes; }
+
+  // Completed iterations of the last search, shallowest first
+  const std::vector<Iteration> &iterations() const { return completed; }
+
+  // Set from another thread to abort the running search. Cleared by the
+  // owner before calling start().
+  std::atomic<bool> stopped{false};
+
+  bool silent = false; // Do not print info lines
+
+  // Shared with later searches so results carry over between moves. The
+  // search runs without one when it is null.
+  TranspositionTable *tt = nullptr;
+
+#ifdef STATS
+  SearchStats stats; // Of the last search, valid once start() returned
+#endif
+
+private:
+  float rootSearch(chess::Board &board, const chess::Movelist &rootMoves,
+                   chess::Move &bestMove);
+  float negamax(chess::Board &board, int depth, int ply, float alpha,
+                float beta);
+  void updatePv(int ply, chess::Move move);
+  std::string iterationInfo(float eval) const;
+  int64_t elapsed() const;
+  bool outOfLimits();
+
+  Limits limits;
+  std::vector<Iteration> completed;
+  int rootDepth = 0; // Depth of the current iteration
+  int seldepth = 0;  // Highest ply reached in the current iteration
+  uint64_t nodes = 0;
+  int64_t timeBudget = 0; // Milliseconds, zero if the search is not timed
+  int64_t lastInfoTime = 0;
+  std::chrono::steady_clock::time_point startTime;
+
+  // Triangular PV table, row ply holds the best line found from that ply
+  chess::Move pvTable[MAX_PLY][MAX_PLY];
+  int pvLength[MAX_PLY];
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "stats.h"
+
+#ifdef STATS
+
+#include <iomanip>
+#include <sstream>
+
+SearchStats &SearchStats::operator+=(const SearchStats &other) {
+  nodes += other.nodes;
+  leafNodes += other.leafNodes;
+  betaCutoffs += other.betaCutoffs;
+  firstMoveCutoffs += other.firstMoveCutoffs;
+  cutoffIndexSum += other.cutoffIndexSum;
+  ttProbes += other.ttProbes;
+  ttHits += other.ttHits;
+  ttCutoffs += other.ttCutoffs;
+  if (iterationNodes.size() < other.iterationNodes.size()) {
+    iterationNodes.resize(other.iterationNodes.size());
+  }
+  for (size_t i = 0; i < other.iterationNodes.size(); i++) {
+    iterationNodes[i] += other.iterationNodes[i];
+  }
+  return *this;
+}
+
+static double ratio(uint64_t part, uint64_t whole) {
+  return whole ? static_cast<double>(part) / whole : 0;
+}
+
+std::string SearchStats::report(bool json) const {
+  const double leafShare = ratio(leafNodes, nodes);
+  const double firstMoveRate = ratio(firstMoveCutoffs, betaCutoffs);
+  const double cutoffIndex = ratio(cutoffIndexSum, betaCutoffs);
+  const double ttHitRate = ratio(ttHits, ttProbes);
+  const double ttCutoffRate = ratio(ttCutoffs, ttProbes);
+
+  // Effective branching factor: growth of the node count per iteration
+  std::ostringstream ebf;
+  ebf << std::fixed << std::setprecision(2);
+  bool first = true;
+  for (size_t i = 1; i < iterationNodes.size(); i++) {
+    ebf << (first ? "" : json ? "," : " ")
+        << ratio(iterationNodes[i], iterationNodes[i - 1]);
+    first = false;
+  }
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3);
+  if (json) {
+    out << "{\"nodes\":" << nodes << ",\"leafNodes\":" << leafNodes
+        << ",\"leafShare\":" << leafShare << ",\"betaCutoffs\":" << betaCutoffs
+        << ",\"firstMoveCutoffRate\":" << firstMoveRate
+        << ",\"avgCutoffIndex\":" << cutoffIndex << ",\"ttProbes\":" << ttProbes
+        << ",\"ttHitRate\":" << ttHitRate << ",\"ttCutoffRate\":" << ttCutoffRate
+        << ",\"ebf\":[" << ebf.str() << "]}";
+  } else {
+    out << "info string nodes " << nodes << " leaf share " << leafShare
+        << "\ninfo string beta cutoffs " << betaCutoffs << " first move "
+        << firstMoveRate << " avg index " << cutoffIndex
+        << "\ninfo string tt probes " << ttProbes << " hits " << ttHitRate
+        << " cutoffs " << ttCutoffRate
+        << "\ninfo string ebf " << ebf.str();
+  }
+  return out.str();
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Search quality counters. They are only collected in builds compiled with
+// -DSTATS (make main-stats); otherwise STAT() expands to nothing and the
+// counters cost nothing.
+#ifdef STATS
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define STAT(expr) expr
+
+struct SearchStats {
+  uint64_t nodes = 0;            // Calls to negamax()
+  uint64_t leafNodes = 0;        // Nodes evaluated at the horizon
+  uint64_t betaCutoffs = 0;
+  uint64_t firstMoveCutoffs = 0; // Beta cutoffs by the first move searched
+  uint64_t cutoffIndexSum = 0;   // Sum of the move index of all beta cutoffs
+  uint64_t ttProbes = 0;
+  uint64_t ttHits = 0;
+  uint64_t ttCutoffs = 0;        // Nodes that returned the stored result
+  std::vector<uint64_t> iterationNodes; // Nodes spent on depth 1, 2, ...
+
+  SearchStats &operator+=(const SearchStats &other);
+
+  // Human readable "info string" lines, or a single line of JSON
+  std::string report(bool json) const;
+};
+
+#else
+
+#define STAT(expr)
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include "tt.h"
+#include "numa.h"
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+using namespace chess;
+
+// Align to the huge page size so the table can be backed by 2 MB pages,
+// which need far fewer TLB entries than 4 KB pages for large tables
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static void *allocateLarge(size_t bytes) {
+#if defined(_WIN32)
+  return _aligned_malloc(bytes, HUGE_PAGE_SIZE);
+#else
+  void *memory = std::aligned_alloc(HUGE_PAGE_SIZE, bytes);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (memory) {
+    madvise(memory, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  return memory;
+#endif
+}
+
+static void freeLarge(void *memory) {
+#if defined(_WIN32)
+  _aligned_free(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+TranspositionTable::~TranspositionTable() { freeLarge(entries); }
+
+void TranspositionTable::resize(size_t megabytes, int threads) {
+  freeLarge(entries);
+  bytes = (megabytes * 1024 * 1024 + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE *
+          HUGE_PAGE_SIZE;
+  entries = static_cast<Entry *>(allocateLarge(bytes));
+  if (!entries) {
+    bytes = 0;
+  }
+  count = bytes / sizeof(Entry);
+  clear(threads);
+}
+
+void TranspositionTable::clear(int threads) {
+  // Zeroing also commits the pages. With NUMA binding each slice ends up on
+  // the node of the thread clearing it.
+  auto clearSlice = [this, threads](int index) {
+    const size_t slice = count / threads;
+    const size_t begin = slice * index;
+    const size_t end = index == threads - 1 ? count : begin + slice;
+    std::memset(static_cast<void *>(entries + begin), 0,
+                (end - begin) * sizeof(Entry));
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++) {
+    pool.emplace_back([&clearSlice, i]() {
+      bindThreadToNode(i);
+      clearSlice(i);
+    });
+  }
+  clearSlice(0);
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  generation = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData &data) const {
+  if (!count) {
+    return false;
+  }
+  const Entry &slot = entry(key);
+  if (slot.key != key || (slot.genBound & BOUND_MASK) == uint8_t(Bound::NONE)) {
+    return false;
+  }
+  data = {slot.eval, Move(slot.move), slot.depth,
+          static_cast<Bound>(slot.genBound & BOUND_MASK)};
+  return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, float eval, Bound bound,
+                               Move move) {
+  if (!count) {
+    return;
+  }
+  // Keep deeper results of the current search, results of the same position
+  // are only kept when they are a lot deeper. Anything from an earlier
+  // search is replaced.
+  Entry &slot = entry(key);
+  const bool current = (slot.genBound & ~BOUND_MASK) == generation;
+  if (current && slot.depth > depth + (slot.key == key ? 2 : 0)) {
+    return;
+  }
+  // Do not lose the best move when a result without one is stored
+  if (move != Move::NO_MOVE || slot.key != key) {
+    slot.move = move.move();
+  }
+  slot.key = key;
+  slot.eval = eval;
+  slot.depth = static_cast<uint8_t>(depth);
+  slot.genBound = generation | static_cast<uint8_t>(bound);
+}
+
+int TranspositionTable::hashfull() const {
+  const size_t samples = std::min<size_t>(1000, count);
+  int used = 0;
+  for (size_t i = 0; i < samples; i++) {
+    used += (entries[i].genBound & BOUND_MASK) != uint8_t(Bound::NONE) &&
+            (entries[i].genBound & ~BOUND_MASK) == generation;
+  }
+  return samples ? static_cast<int>(used * 1000 / samples) : 0;
+}
@@ -0,0 +1,78 @@
+#ifndef TT_H
+#define TT_H
+
+#include "chess.hpp"
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t DEFAULT_HASH = 16; // Megabytes
+constexpr size_t MAX_HASH = 65536;
+
+enum class Bound : uint8_t { NONE, UPPER, LOWER, EXACT };
+
+// Result of a successful probe. Mate scores are relative to the stored
+// node, the search converts them to and from its own ply.
+struct TTData {
+  float eval;
+  chess::Move move;
+  int depth;
+  Bound bound;
+};
+
+// Hash table of search results keyed on the Zobrist key of a position. It is
+// kept across searches; entries of earlier searches are recognized by their
+// generation and replaced first.
+class TranspositionTable {
+public:
+  TranspositionTable() = default;
+  TranspositionTable(const TranspositionTable &) = delete;
+  TranspositionTable &operator=(const TranspositionTable &) = delete;
+  ~TranspositionTable();
+
+  // Reallocate with the given size and clear with this many threads
+  void resize(size_t megabytes, int threads);
+
+  // Zero the table, every thread takes a disjoint slice
+  void clear(int threads);
+
+  // Called at the start of every search to age the existing entries
+  void newSearch() { generation += GENERATION_STEP; }
+
+  // Start loading the entry of a position that is about to be searched
+  void prefetch(uint64_t key) const {
+    if (count) {
+      __builtin_prefetch(&entry(key));
+    }
+  }
+
+  bool probe(uint64_t key, TTData &data) const;
+  void store(uint64_t key, int depth, float eval, Bound bound, chess::Move move);
+
+  // Permille of entries written by the current search, sampled
+  int hashfull() const;
+
+private:
+  struct Entry {
+    uint64_t key;
+    float eval;
+    uint16_t move;
+    uint8_t depth;
+    uint8_t genBound; // Generation in the upper six bits, bound below
+  };
+  static_assert(sizeof(Entry) == 16, "four entries per cache line");
+
+  static constexpr uint8_t GENERATION_STEP = 4;
+  static constexpr uint8_t BOUND_MASK = 3;
+
+  Entry &entry(uint64_t key) const {
+    // Map the key onto the table without requiring a power of two size
+    return entries[static_cast<uint64_t>((static_cast<unsigned __int128>(key) * count) >> 64)];
+  }
+
+  Entry *entries = nullptr;
+  size_t count = 0;
+  size_t bytes = 0;
+  uint8_t generation = 0;
+};
+
+#endif